@@ -0,0 +1,236 @@
+#include "BatchEvaluator.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "Profiler.h"
+
+namespace {
+    // Speed of the knapsack for a weight, as PSOParticle::calculate_speed
+    struct SpeedModel {
+        double capacity;
+        double v_max;
+        double v_min;
+
+        inline double operator()(double weight) const
+        {
+            return (weight <= capacity) ? (v_max - weight * (v_max - v_min) / capacity) : v_min;
+        }
+    };
+
+    // Scratch of a single evaluation on the calling thread, grown to the longest tour it has scored
+    thread_local vector<double> weight_scratch;
+    thread_local vector<double> time_scratch;
+
+#ifdef __AVX2__
+    // Speeds of four weights, with the same operations as the scalar speed
+    inline __m256d speeds(__m256d weight, const SpeedModel& speed)
+    {
+        __m256d moving = _mm256_sub_pd(_mm256_set1_pd(speed.v_max), _mm256_div_pd(
+            _mm256_mul_pd(weight, _mm256_set1_pd(speed.v_max - speed.v_min)), _mm256_set1_pd(speed.capacity)));
+        __m256d fits = _mm256_cmp_pd(weight, _mm256_set1_pd(speed.capacity), _CMP_LE_OQ);
+        return _mm256_blendv_pd(_mm256_set1_pd(speed.v_min), moving, fits);
+    }
+
+    // Four coordinates. The masked gather with a zero source is the same as the plain one, which GCC
+    // reports as reading an uninitialised register.
+    inline __m256d gather(const double* values, __m128i index)
+    {
+        __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), values, index, all, 8);
+    }
+
+    // Euclidean lengths of four edges, from the gathered coordinates
+    inline __m256d euclidean(const double* xs, const double* ys, __m128i from, __m128i to)
+    {
+        __m256d dx = _mm256_sub_pd(gather(xs, from), gather(xs, to));
+        __m256d dy = _mm256_sub_pd(gather(ys, from), gather(ys, to));
+        return _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+    }
+
+    inline __m256d gather_distances(const DistanceOracle::MatrixDistances& distance, __m128i from, __m128i to)
+    {
+        __m128i index = _mm_add_epi32(_mm_mullo_epi32(from, _mm_set1_epi32(static_cast<int>(distance.num_cities))), to);
+        return _mm256_cvtepi32_pd(_mm_i32gather_epi32(distance.matrix, index, 4));
+    }
+
+    inline __m256d gather_distances(const DistanceOracle::ComputedDistances<Ceil2DMetric>& distance, __m128i from, __m128i to)
+    {
+        return _mm256_ceil_pd(euclidean(distance.xs, distance.ys, from, to));
+    }
+
+    inline __m256d gather_distances(const DistanceOracle::ComputedDistances<Euc2DMetric>& distance, __m128i from, __m128i to)
+    {
+        return _mm256_floor_pd(_mm256_add_pd(euclidean(distance.xs, distance.ys, from, to), _mm256_set1_pd(0.5)));
+    }
+
+    // GEO needs acos and stays scalar
+    template <class Distances>
+    constexpr bool has_gather = is_same_v<Distances, DistanceOracle::MatrixDistances>
+        || is_same_v<Distances, DistanceOracle::ComputedDistances<Ceil2DMetric>>
+        || is_same_v<Distances, DistanceOracle::ComputedDistances<Euc2DMetric>>;
+#endif
+
+    // Time of every edge of the tour, times[k] is the edge from tour[k] to the next city
+    template <class Distances>
+    void edge_times(const Distances& distance, const int* tour, size_t n, const double* weight_at,
+        const SpeedModel& speed, double* times)
+    {
+        size_t k = 0;
+
+#ifdef __AVX2__
+        if constexpr (has_gather<Distances>)
+        {
+            // Matrix offsets are 32-bit in the gather
+            bool fits = true;
+            if constexpr (is_same_v<Distances, DistanceOracle::MatrixDistances>)
+            {
+                fits = distance.num_cities <= 46340;
+            }
+
+            // Four edges at a time, up to the last edge that does not wrap around
+            for (; fits && k + 4 < n; k += 4)
+            {
+                __m128i from = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tour + k));
+                __m128i to = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tour + k + 1));
+                __m256d lengths = gather_distances(distance, from, to);
+                _mm256_storeu_pd(times + k, _mm256_div_pd(lengths, speeds(_mm256_loadu_pd(weight_at + k), speed)));
+            }
+        }
+#endif
+
+        for (; k + 1 < n; ++k)
+        {
+            times[k] = distance(tour[k], tour[k + 1]) / speed(weight_at[k]);
+        }
+
+        // Return to the starting city
+        if (n > 0)
+        {
+            times[n - 1] = distance(tour[n - 1], tour[0]) / speed(weight_at[n - 1]);
+        }
+    }
+}
+
+
+BatchEvaluator::BatchEvaluator(const DistanceOracle& distances, const ItemStore& items, double capacity, double rent_rate,
+    double v_max, double v_min)
+    :distances(distances), items(items), capacity(capacity), rent_rate(rent_rate), v_max(v_max), v_min(v_min)
+{
+}
+
+
+void BatchEvaluator::evaluate(const vector<BatchCandidate>& candidates, vector<FitnessValues>& values, ThreadPool& pool) const
+{
+    values.resize(candidates.size());
+    if (candidates.empty())
+    {
+        return;
+    }
+
+    // The candidates are split in one lane of consecutive candidates per thread that can take part. Every
+    // lane has its own part of the scratch, sized here, so no thread grows its own scratch later on.
+    size_t num_lanes = min(candidates.size(), pool.size() + 1);
+    size_t longest = 0;
+    for (const auto& candidate : candidates)
+    {
+        longest = max(longest, candidate.tour->size());
+    }
+    if (batch_scratch.size() < 2 * num_lanes * longest)
+    {
+        batch_scratch.resize(2 * num_lanes * longest);
+    }
+
+    // Every candidate is vectorised along its tour, the lanes are spread over the pool
+    pool.parallel_for(0, num_lanes, [&](size_t lane) {
+        double* weight_at = batch_scratch.data() + 2 * lane * longest;
+        double* times = weight_at + longest;
+        size_t last = (lane + 1) * candidates.size() / num_lanes;
+        for (size_t i = lane * candidates.size() / num_lanes; i < last; ++i)
+        {
+            values[i] = score(*candidates[i].tour, *candidates[i].plan, weight_at, times);
+        }
+    });
+}
+
+
+FitnessValues BatchEvaluator::evaluate(const vector<int>& tour, const PickingPlan& plan) const
+{
+    size_t n = tour.size();
+    if (weight_scratch.size() < n)
+    {
+        weight_scratch.resize(n);
+        time_scratch.resize(n);
+    }
+    return score(tour, plan, weight_scratch.data(), time_scratch.data());
+}
+
+
+FitnessValues BatchEvaluator::score(const vector<int>& tour, const PickingPlan& plan, double* weight_at, double* times) const
+{
+    Profiler::instance().add(Counter::Evaluations);
+
+    size_t n = tour.size();
+
+    // A plan that fits as a whole loses no item on the way, its profit is a masked sum over the words of the
+    // plan and the walk below only accumulates the weights
+    double total_profit = 0;
+    double current_weight = 0;
+    bool fits = static_cast<double>(masked_sum(plan, items.weight_data())) <= capacity;
+    if (fits)
+    {
+        total_profit = static_cast<double>(masked_sum(plan, items.profit_data()));
+    }
+
+    // Knapsack weight after every city of the tour, an item that does not fit any more is skipped
+    for (size_t k = 0; k < n; ++k)
+    {
+        int city = tour[k];
+        for (const int* item = items.city_begin(city); item != items.city_end(city); ++item)
+        {
+            if (!plan[*item])
+            {
+                continue;
+            }
+            if (fits)
+            {
+                current_weight += items.weight(*item);
+            }
+            else if (current_weight + items.weight(*item) <= capacity)
+            {
+                current_weight += items.weight(*item);
+                total_profit += items.profit(*item);
+            }
+        }
+        weight_at[k] = current_weight;
+    }
+
+    // Time of every edge, on the distance source of the instance metric
+    SpeedModel speed{ capacity, v_max, v_min };
+    distances.dispatch([&](const auto& distance) {
+        edge_times(distance, tour.data(), n, weight_at, speed, times);
+    });
+
+    // Summed in tour order, as the scalar evaluation does
+    double travel_time = 0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        travel_time += times[k];
+    }
+
+    return FitnessValues{ total_profit - rent_rate * travel_time, total_profit, current_weight, travel_time };
+}
+
+
+bool BatchEvaluator::is_vectorised()
+{
+#ifdef __AVX2__
+    return true;
+#else
+    return false;
+#endif
+}
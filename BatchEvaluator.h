@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+
+#include "DistanceOracle.h"
+#include "ItemStore.h"
+#include "PickingPlan.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+/// <summary>
+/// Tour and picking plan of one candidate solution of a batch
+/// </summary>
+struct BatchCandidate {
+    const vector<int>* tour;
+    const PickingPlan* plan;
+};
+
+/// <summary>
+/// Objective of one candidate: fitness = profit - rent rate * time
+/// </summary>
+struct FitnessValues {
+    double fitness, profit, weight, time;
+};
+
+/// <summary>
+/// Evaluator of the TTP objective for many candidate solutions at once, the particles of a swarm or the
+/// neighbours of one particle. Every candidate is scored in two passes: the knapsack weight after every
+/// city in tour order, then the time of every edge. The edge pass gathers the coordinates or the matrix
+/// entries of four edges at a time with AVX2 when the build enables it, and is scalar otherwise. The
+/// edge times are summed in tour order, so the results are the same as the scalar evaluation bit for bit.
+/// </summary>
+class BatchEvaluator {
+public:
+    BatchEvaluator(const DistanceOracle& distances, const ItemStore& items, double capacity, double rent_rate,
+        double v_max, double v_min);
+
+    /// <summary>
+    /// Scores every candidate, concurrently on the pool. values[i] is the objective of candidates[i].
+    /// Items that do not fit in the knapsack when their city is reached are skipped, the plans are not changed.
+    /// The scratch of the batch is kept by the evaluator, so one batch runs on an evaluator at a time.
+    /// </summary>
+    /// <param name="candidates"></param>
+    /// <param name="values"></param>
+    /// <param name="pool"></param>
+    void evaluate(const vector<BatchCandidate>& candidates, vector<FitnessValues>& values,
+        ThreadPool& pool = ThreadPool::instance()) const;
+
+    /// <summary>
+    /// Scores one candidate on the calling thread, with the scratch of the thread. Any number of threads
+    /// can score candidates at the same time.
+    /// </summary>
+    /// <param name="tour"></param>
+    /// <param name="plan"></param>
+    /// <returns>FitnessValues</returns>
+    FitnessValues evaluate(const vector<int>& tour, const PickingPlan& plan) const;
+
+    /// <summary>
+    /// Returns true if the edge pass was built with AVX2
+    /// </summary>
+    static bool is_vectorised();
+
+private:
+
+    // Scores one candidate with the given scratch, one weight and one edge time per city of the tour
+    FitnessValues score(const vector<int>& tour, const PickingPlan& plan, double* weight_at, double* times) const;
+
+    const DistanceOracle& distances;
+    const ItemStore& items;
+    double capacity;
+    double rent_rate;
+    double v_max;
+    double v_min;
+
+    // Weights and edge times of every lane of a batch, grown to the largest batch scored so far
+    mutable vector<double> batch_scratch;
+};
@@ -0,0 +1,180 @@
+#include "BatchRunner.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "DistanceOracle.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    // City-particle pairs that keep one thread busy, smaller swarms run on a single thread
+    const size_t work_per_thread = 100000;
+
+    // Reads the number after the colon of a header line
+    size_t header_value(const string& line)
+    {
+        size_t colon = line.find(':');
+        return colon == string::npos ? 0 : static_cast<size_t>(strtoull(line.c_str() + colon + 1, nullptr, 10));
+    }
+}
+
+
+JobEstimate estimate_job(const string& file_path, size_t num_particles, size_t num_candidates)
+{
+    JobEstimate estimate;
+
+    ifstream file(file_path);
+    string line;
+    bool explicit_weights = false;
+    while (getline(file, line))
+    {
+        if (line.rfind("DIMENSION", 0) == 0)
+        {
+            estimate.num_cities = header_value(line);
+        }
+        else if (line.rfind("NUMBER OF ITEMS", 0) == 0)
+        {
+            estimate.num_items = header_value(line);
+        }
+        else if (line.rfind("EDGE_WEIGHT_TYPE", 0) == 0)
+        {
+            explicit_weights = line.find("EXPLICIT") != string::npos;
+        }
+        else if (line.rfind("NODE_COORD_SECTION", 0) == 0 || line.rfind("EDGE_WEIGHT_SECTION", 0) == 0)
+        {
+            break;
+        }
+    }
+
+    size_t cities = estimate.num_cities;
+    size_t items = estimate.num_items;
+
+    // The mapped file or cache, nodes, distance oracle with its dense matrix, candidate lists and item store
+    file.clear();
+    file.seekg(0, ios::end);
+    size_t instance_bytes = static_cast<size_t>(max<streamoff>(0, file.tellg()))
+        + cities * (48 + num_candidates * sizeof(int)) + items * 64
+        + DistanceOracle::matrix_bytes(cities, explicit_weights);
+
+    // Tour, best tour, velocity, random numbers, evaluator and tour engine arrays of every particle
+    size_t particle_bytes = cities * 96 + items * 48;
+
+    // A quarter on top for the allocator and the containers' spare capacity
+    estimate.memory_bytes = (instance_bytes + num_particles * particle_bytes) / 4 * 5;
+    estimate.threads = clamp<size_t>((cities * num_particles + work_per_thread - 1) / work_per_thread, 1,
+        max<size_t>(1, num_particles));
+    return estimate;
+}
+
+
+#ifdef _WIN32
+size_t physical_memory()
+{
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    return GlobalMemoryStatusEx(&status) ? static_cast<size_t>(status.ullTotalPhys) : 0;
+}
+#else
+size_t physical_memory()
+{
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGE_SIZE);
+    return pages > 0 && page_size > 0 ? static_cast<size_t>(pages) * static_cast<size_t>(page_size) : 0;
+}
+#endif
+
+
+BatchRunner::BatchRunner(size_t memory_budget, size_t core_budget)
+    :memory_budget(memory_budget), core_budget(max<size_t>(1, core_budget)), memory_used(0), cores_used(0), running(0)
+{
+}
+
+
+void BatchRunner::add(const string& file_path, const JobEstimate& estimate)
+{
+    BatchJob job;
+    job.file_path = file_path;
+    job.estimate = estimate;
+    job.threads = min(max<size_t>(1, estimate.threads), core_budget);
+    jobs.push_back(job);
+    started.push_back(false);
+}
+
+
+size_t BatchRunner::next_admissible() const
+{
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (started[i])
+        {
+            continue;
+        }
+
+        // Nothing else is running, so the job runs even if it is larger than the budgets
+        if (running == 0)
+        {
+            return i;
+        }
+        if (memory_used + jobs[i].estimate.memory_bytes <= memory_budget && cores_used + jobs[i].threads <= core_budget)
+        {
+            return i;
+        }
+    }
+    return jobs.size();
+}
+
+
+void BatchRunner::run(const function<void(const BatchJob&)>& body)
+{
+    vector<thread> workers;
+    size_t remaining = jobs.size();
+
+    unique_lock<mutex> lock(mtx);
+    while (remaining > 0)
+    {
+        size_t i = 0;
+        job_done.wait(lock, [&]() { return (i = next_admissible()) < jobs.size(); });
+
+        BatchJob& job = jobs[i];
+        started[i] = true;
+        remaining--;
+        running++;
+        memory_used += job.estimate.memory_bytes;
+        cores_used += job.threads;
+
+        workers.emplace_back([this, &body, &job]() {
+            try
+            {
+                body(job);
+            }
+            catch (const exception& e)
+            {
+                cerr << "Job " << job.file_path << " failed: " << e.what() << endl;
+            }
+
+            // Hand the budgets back and let the next jobs in
+            {
+                lock_guard<mutex> done(mtx);
+                running--;
+                memory_used -= job.estimate.memory_bytes;
+                cores_used -= job.threads;
+            }
+            job_done.notify_all();
+        });
+    }
+    lock.unlock();
+
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// <summary>
+/// Resources an instance is expected to need, estimated from its header before it is loaded
+/// </summary>
+struct JobEstimate {
+    size_t num_cities = 0;
+    size_t num_items = 0;
+
+    // Rough upper bound of the memory of the loaded instance and its swarm in bytes
+    size_t memory_bytes = 0;
+
+    // Threads the swarm of the instance keeps busy
+    size_t threads = 1;
+};
+
+/// <summary>
+/// Instance admitted by the batch runner, with the threads it was given
+/// </summary>
+struct BatchJob {
+    string file_path;
+    JobEstimate estimate;
+    size_t threads = 1;
+};
+
+/// <summary>
+/// Reads the DIMENSION and NUMBER OF ITEMS of an instance from its header, without loading the instance,
+/// and estimates the memory and threads of a swarm of num_particles particles on it
+/// </summary>
+/// <param name="file_path"></param>
+/// <param name="num_particles"></param>
+/// <param name="num_candidates">Nearest neighbour candidates per city</param>
+/// <returns></returns>
+JobEstimate estimate_job(const string& file_path, size_t num_particles, size_t num_candidates);
+
+/// <summary>
+/// Physical memory of the host in bytes, 0 if it is unknown
+/// </summary>
+size_t physical_memory();
+
+/// <summary>
+/// Runs a batch of instances concurrently within a memory and a core budget. The queued jobs are admitted
+/// in order, a job that does not fit yet lets smaller jobs behind it start first. A job larger than the
+/// budgets on its own runs once nothing else is running, with its threads cut to the core budget.
+/// </summary>
+class BatchRunner {
+public:
+    BatchRunner(size_t memory_budget, size_t core_budget);
+
+    /// <summary>
+    /// Queues an instance with its estimate
+    /// </summary>
+    void add(const string& file_path, const JobEstimate& estimate);
+
+    /// <summary>
+    /// Runs every queued job on its own thread and returns when all are done. An exception thrown by a job
+    /// is reported and does not stop the other jobs.
+    /// </summary>
+    void run(const function<void(const BatchJob&)>& body);
+
+    inline size_t size() const { return jobs.size(); }
+
+private:
+
+    // Index of the first queued job that fits the free budgets, jobs.size() if none fits
+    size_t next_admissible() const;
+
+    size_t memory_budget;
+    size_t core_budget;
+
+    vector<BatchJob> jobs;
+    vector<bool> started;
+
+    // Budgets used by the running jobs
+    mutex mtx;
+    condition_variable job_done;
+    size_t memory_used;
+    size_t cores_used;
+    size_t running;
+};
@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <new>
+#include "HelperClasses.h"
+#include "HelperFunctions.h"
+#include "InstanceCache.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------------------------------------------------------
+// Allocation counting, every operator new of the process goes through these counters
+//------------------------------------------------------------------------------------------------------------------------
+static atomic<size_t> allocation_count(0);
+static atomic<size_t> allocation_bytes(0);
+
+void* operator new(size_t size)
+{
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    allocation_bytes.fetch_add(size, memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// GCC pairs free with the standard operator new and warns, the replacement above uses malloc
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------
+// Access to the private kernels of a particle
+//------------------------------------------------------------------------------------------------------------------------
+class ParticleKernels {
+public:
+    // Random tour and a valid picking plan, without the local search run by initialise
+    static void randomise(PSOParticle& p, Xoshiro256& rng)
+    {
+        p.tour.resize(p.num_cities);
+        iota(p.tour.begin(), p.tour.end(), 0);
+        shuffle(p.tour.begin(), p.tour.end(), rng);
+        p.picking_plan = PickingPlan(p.num_items);
+        p.generate_valid_picking_plan();
+        p.velocity.assign(p.num_cities + p.num_items, 0.0);
+        p.best_position = { p.tour, p.picking_plan };
+    }
+
+    static double tsp_distance(PSOParticle& p) { return p.calculateTSPDistance(p.tour); }
+
+    static void two_opt(PSOParticle& p) { p.twoOpt(); }
+
+    static void bit_flip(PSOParticle& p) { p.bitFlipSearch(); }
+
+    static vector<int>& tour(PSOParticle& p) { return p.tour; }
+
+    static PickingPlan& picking_plan(PSOParticle& p) { return p.picking_plan; }
+};
+
+
+//------------------------------------------------------------------------------------------------------------------------
+// Benchmark runner
+//------------------------------------------------------------------------------------------------------------------------
+struct BenchmarkResult {
+    string kernel;
+    string instance;
+    int repetitions;
+    double best_ns;
+    double median_ns;
+    // Elements processed by one call, and their unit
+    double elements;
+    string unit;
+    // Allocations and allocated bytes of one call
+    double allocations;
+    double bytes;
+};
+
+struct BenchmarkOptions {
+    string input_directory = "tests/";
+    int warmup = 1;
+    int repetitions = 5;
+    string filter;
+    string json_path;
+    string csv_path;
+    // Fail if a kernel of a steady-state iteration allocates
+    bool check_allocations = false;
+};
+
+
+// Times a kernel, the setup runs before every call and is neither timed nor counted
+template <class Setup, class Kernel>
+BenchmarkResult run_kernel(const BenchmarkOptions& options, const string& kernel, const string& instance,
+    double elements, const string& unit, Setup&& setup, Kernel&& body)
+{
+    vector<double> times;
+    size_t allocations = 0;
+    size_t bytes = 0;
+
+    for (int r = 0; r < options.warmup + options.repetitions; ++r)
+    {
+        setup();
+
+        size_t count_before = allocation_count.load(memory_order_relaxed);
+        size_t bytes_before = allocation_bytes.load(memory_order_relaxed);
+        auto start = chrono::steady_clock::now();
+        body();
+        auto end = chrono::steady_clock::now();
+        size_t count_after = allocation_count.load(memory_order_relaxed);
+        size_t bytes_after = allocation_bytes.load(memory_order_relaxed);
+
+        if (r >= options.warmup)
+        {
+            times.push_back(chrono::duration<double, nano>(end - start).count());
+            allocations += count_after - count_before;
+            bytes += bytes_after - bytes_before;
+        }
+    }
+
+    sort(times.begin(), times.end());
+    double reps = static_cast<double>(options.repetitions);
+    return BenchmarkResult{ kernel, instance, options.repetitions, times.front(), times[times.size() / 2],
+        elements, unit, allocations / reps, bytes / reps };
+}
+
+
+void print_result(const BenchmarkResult& r)
+{
+    cout << left << setw(18) << r.kernel << setw(26) << r.instance << right << fixed << setprecision(0)
+        << setw(16) << r.best_ns << setw(16) << r.median_ns << setprecision(2)
+        << setw(14) << r.elements / r.best_ns * 1e3 << ' ' << left << setw(10) << ("M" + r.unit + "/s") << right
+        << setprecision(1) << setw(12) << r.allocations << setw(14) << r.bytes << endl;
+}
+
+
+void write_json(const string& path, const vector<BenchmarkResult>& results)
+{
+    ofstream file(path);
+    file << "[\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& r = results[i];
+        file << setprecision(10) << "  {\"kernel\": \"" << r.kernel << "\", \"instance\": \"" << json_escape(r.instance)
+            << "\", \"repetitions\": " << r.repetitions << ", \"best_ns\": " << r.best_ns
+            << ", \"median_ns\": " << r.median_ns << ", \"elements\": " << r.elements
+            << ", \"unit\": \"" << r.unit << "\", \"allocations\": " << r.allocations
+            << ", \"bytes\": " << r.bytes << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "]\n";
+}
+
+
+void write_csv(const string& path, const vector<BenchmarkResult>& results)
+{
+    ofstream file(path);
+    file << "kernel,instance,repetitions,best_ns,median_ns,elements,unit,allocations,bytes\n";
+    for (const auto& r : results)
+    {
+        file << setprecision(10) << r.kernel << ',' << r.instance << ',' << r.repetitions << ',' << r.best_ns << ','
+            << r.median_ns << ',' << r.elements << ',' << r.unit << ',' << r.allocations << ',' << r.bytes << "\n";
+    }
+}
+
+
+BenchmarkOptions parse_options(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--warmup" && has_value)
+        {
+            options.warmup = max(0, stoi(argv[++i]));
+        }
+        else if (arg == "--reps" && has_value)
+        {
+            options.repetitions = max(1, stoi(argv[++i]));
+        }
+        else if (arg == "--filter" && has_value)
+        {
+            options.filter = argv[++i];
+        }
+        else if (arg == "--json" && has_value)
+        {
+            options.json_path = argv[++i];
+        }
+        else if (arg == "--csv" && has_value)
+        {
+            options.csv_path = argv[++i];
+        }
+        else if (arg == "--check-allocations")
+        {
+            options.check_allocations = true;
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            cerr << "Usage: Benchmark [directory] [--warmup N] [--reps N] [--filter kernel] [--json file] [--csv file] [--check-allocations]" << endl;
+            exit(1);
+        }
+        else
+        {
+            options.input_directory = arg;
+        }
+    }
+    return options;
+}
+
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options = parse_options(argc, argv);
+    vector<BenchmarkResult> results;
+
+    // Runs a kernel unless it is filtered out
+    auto bench = [&](const string& kernel, const string& instance, double elements, const string& unit,
+        auto&& setup, auto&& body) {
+        if (!options.filter.empty() && kernel.find(options.filter) == string::npos)
+        {
+            return;
+        }
+        results.push_back(run_kernel(options, kernel, instance, elements, unit, setup, body));
+        print_result(results.back());
+    };
+    auto no_setup = []() {};
+
+    cout << left << setw(18) << "kernel" << setw(26) << "instance" << right << setw(16) << "best ns" << setw(16)
+        << "median ns" << setw(25) << "throughput" << setw(12) << "allocs" << setw(14) << "bytes" << endl;
+
+    // Instances in name order, so runs are comparable
+    vector<filesystem::path> instances;
+    for (const auto& entry : filesystem::directory_iterator(options.input_directory))
+    {
+        if (!InstanceCache::is_cache_file(entry.path().string()))
+        {
+            instances.push_back(entry.path());
+        }
+    }
+    sort(instances.begin(), instances.end());
+
+    for (const auto& path : instances)
+    {
+        string file_path = path.string();
+        string name = path.filename().string();
+        double bytes = static_cast<double>(filesystem::file_size(path));
+
+        // Instance file parsing, against a plain scan over the mapped bytes
+        bench("scan", name, bytes, "B", no_setup, [&]() {
+            MappedFile file(file_path);
+            volatile size_t lines = count(file.data(), file.data() + file.size(), '\n');
+            (void)lines;
+        });
+
+        // A file that is not a valid instance is skipped, the others are still measured
+        ParsedData parsed_data;
+        try
+        {
+            parsed_data = parse_bttp_file(file_path);
+        }
+        catch (const exception& e)
+        {
+            cerr << "Skipping " << name << ": " << e.what() << endl;
+            continue;
+        }
+        bench("parse", name, bytes, "B", no_setup, [&]() {
+            ParsedData parsed = parse_bttp_file(file_path);
+        });
+
+        size_t num_cities = static_cast<size_t>(parsed_data.metadata["DIMENSION"]);
+        size_t num_items = static_cast<size_t>(parsed_data.metadata["NUMBER_OF_ITEMS"]) + 1;
+
+        // Loading from the binary cache, the first (warmup) call writes it if needed
+        bench("cache_load", name, static_cast<double>(num_items), "item", no_setup, [&]() {
+            Instance instance = load_instance(file_path);
+        });
+
+        // Preprocessing of the instance
+        bench("item_store", name, static_cast<double>(num_items), "item", no_setup, [&]() {
+            ItemStore store(parsed_data.items, num_cities);
+        });
+
+        bench("distance_oracle", name, static_cast<double>(num_cities), "city", no_setup, [&]() {
+            DistanceOracle oracle(parsed_data);
+        });
+
+        bench("candidates", name, static_cast<double>(num_cities), "city", no_setup, [&]() {
+            CandidateLists lists(parsed_data.nodes);
+        });
+
+        if (num_cities < 4)
+        {
+            continue;
+        }
+
+        // Particle kernels, on a random tour and a valid picking plan drawn from a fixed seed
+        ItemStore items(parsed_data.items, num_cities);
+        DistanceOracle distances(parsed_data);
+        CandidateLists candidates(parsed_data.nodes);
+        double capacity = parsed_data.metadata["CAPACITY"];
+        double v_max = parsed_data.metadata["MAX_SPEED"];
+        double v_min = parsed_data.metadata["MIN_SPEED"];
+        double rent_rate = parsed_data.metadata["RENTING_RATIO"];
+
+        Xoshiro256 rng(1);
+        Deadline no_deadline;
+        bench("instance_context", name, static_cast<double>(num_items), "item", no_setup, [&]() {
+            InstanceContext preprocessed(distances, candidates, items);
+        });
+
+        InstanceContext context(distances, candidates, items);
+        PSOParticle particle(context, static_cast<int>(num_cities), static_cast<int>(num_items),
+            capacity, v_max, v_min, rent_rate, rng.split(), no_deadline);
+        ParticleKernels::randomise(particle, rng);
+        const vector<int> random_tour = ParticleKernels::tour(particle);
+        const PickingPlan random_plan = ParticleKernels::picking_plan(particle);
+
+        volatile double sink = 0;
+        bench("tsp_distance", name, static_cast<double>(num_cities), "edge", no_setup, [&]() {
+            sink = ParticleKernels::tsp_distance(particle);
+        });
+
+        bench("evaluate_fitness", name, static_cast<double>(num_cities + num_items), "elem", no_setup, [&]() {
+            sink = particle.evaluate_fitness(distances, items, capacity, rent_rate, v_max, v_min).fitness;
+        });
+
+        // A swarm of random tours scored in one batch
+        const size_t batch_size = 20;
+        vector<vector<int>> batch_tours(batch_size, random_tour);
+        vector<BatchCandidate> batch;
+        for (auto& batch_tour : batch_tours)
+        {
+            shuffle(batch_tour.begin(), batch_tour.end(), rng);
+            batch.push_back(BatchCandidate{ &batch_tour, &random_plan });
+        }
+        BatchEvaluator evaluator(distances, items, capacity, rent_rate, v_max, v_min);
+        vector<FitnessValues> batch_values;
+        bench("evaluate_batch", name, static_cast<double>(batch_size * (num_cities + num_items)), "elem", no_setup, [&]() {
+            evaluator.evaluate(batch, batch_values);
+        });
+
+        // The local searches start again from the random tour and plan on every call
+        auto reset = [&]() {
+            ParticleKernels::tour(particle) = random_tour;
+            ParticleKernels::picking_plan(particle) = random_plan;
+        };
+
+        bench("two_opt", name, static_cast<double>(num_cities), "city", reset, [&]() {
+            ParticleKernels::two_opt(particle);
+        });
+
+        bench("bit_flip", name, static_cast<double>(num_items), "item", reset, [&]() {
+            ParticleKernels::bit_flip(particle);
+        });
+
+        // One iteration of a small swarm, evaluation and position update. The swarm is built on the first
+        // call and runs some iterations first, so the calls measure the steady state. The front is the only
+        // storage left that grows, its pool keeps the nodes of the removed points and rarely runs out after
+        // these iterations.
+        const size_t swarm_size = 10;
+        unique_ptr<PSO> swarm;
+        auto start_swarm = [&]() {
+            if (!swarm)
+            {
+                swarm = make_unique<PSO>(swarm_size, context, num_cities, num_items, capacity, v_max, v_min, rent_rate,
+                    LocalSearchMode::Restrictive, 1);
+                swarm->run(50, 0.9, 1.4, 1.5);
+            }
+        };
+        bench("swarm_iteration", name, static_cast<double>(swarm_size * (num_cities + num_items)), "elem", start_swarm, [&]() {
+            swarm->run(1, 0.9, 1.4, 1.5);
+        });
+    }
+
+    if (!options.json_path.empty())
+    {
+        write_json(options.json_path, results);
+    }
+    if (!options.csv_path.empty())
+    {
+        write_csv(options.csv_path, results);
+    }
+
+    // The kernels run on every iteration of a swarm reuse the storage of the previous call
+    if (options.check_allocations)
+    {
+        const vector<string> allocation_free = { "tsp_distance", "evaluate_fitness", "evaluate_batch", "two_opt",
+            "bit_flip", "swarm_iteration" };
+        bool allocated = false;
+        for (const auto& r : results)
+        {
+            if (r.allocations > 0 && find(allocation_free.begin(), allocation_free.end(), r.kernel) != allocation_free.end())
+            {
+                cerr << r.kernel << " allocates " << r.allocations << " times per call on " << r.instance << endl;
+                allocated = true;
+            }
+        }
+        if (allocated)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include "CandidateLists.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+#include "DistanceOracle.h"
+#include "Profiler.h"
+
+CandidateLists::CandidateLists(const vector<pair<double, double>>& coordinates, size_t k)
+    :k(0)
+{
+    ScopedTimer timer(Phase::Preprocess);
+
+    size_t num_cities = coordinates.size();
+    if (num_cities < 2)
+    {
+        return;
+    }
+    this->k = min(k, num_cities - 1);
+
+    // Bounding box of the instance
+    double min_x = coordinates[0].first, max_x = min_x;
+    double min_y = coordinates[0].second, max_y = min_y;
+    for (const auto& [x, y] : coordinates)
+    {
+        min_x = min(min_x, x);
+        max_x = max(max_x, x);
+        min_y = min(min_y, y);
+        max_y = max(max_y, y);
+    }
+
+    // Uniform grid with about two cities per cell
+    double width = max_x - min_x + 1.0;
+    double height = max_y - min_y + 1.0;
+    double cell_size = max(1.0, sqrt(2.0 * width * height / num_cities));
+    long long cols = static_cast<long long>(width / cell_size) + 1;
+    long long rows = static_cast<long long>(height / cell_size) + 1;
+
+    // Bucket the cities by cell, cell_start holds the offset of every cell in cell_cities
+    vector<long long> cell_of(num_cities);
+    vector<int> cell_start(cols * rows + 1, 0);
+    for (size_t i = 0; i < num_cities; ++i)
+    {
+        long long cx = static_cast<long long>((coordinates[i].first - min_x) / cell_size);
+        long long cy = static_cast<long long>((coordinates[i].second - min_y) / cell_size);
+        cell_of[i] = cy * cols + cx;
+        cell_start[cell_of[i] + 1]++;
+    }
+    for (size_t c = 1; c < cell_start.size(); ++c)
+    {
+        cell_start[c] += cell_start[c - 1];
+    }
+
+    vector<int> cell_cities(num_cities);
+    vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+    for (size_t i = 0; i < num_cities; ++i)
+    {
+        cell_cities[fill[cell_of[i]]++] = static_cast<int>(i);
+    }
+
+    neighbors.resize(num_cities * this->k);
+
+    // Max-heap on the squared distance, the top is the worst of the current k candidates
+    priority_queue<pair<double, int>> heap;
+    vector<pair<double, int>> sorted;
+
+    for (size_t i = 0; i < num_cities; ++i)
+    {
+        double x = coordinates[i].first, y = coordinates[i].second;
+        long long cx = cell_of[i] % cols, cy = cell_of[i] / cols;
+
+        auto visit_cell = [&](long long gx, long long gy) {
+            if (gx < 0 || gy < 0 || gx >= cols || gy >= rows)
+            {
+                return;
+            }
+            long long cell = gy * cols + gx;
+            for (int c = cell_start[cell]; c < cell_start[cell + 1]; ++c)
+            {
+                int other = cell_cities[c];
+                if (other == static_cast<int>(i))
+                {
+                    continue;
+                }
+                double dx = coordinates[other].first - x;
+                double dy = coordinates[other].second - y;
+                double d = dx * dx + dy * dy;
+                if (heap.size() < this->k)
+                {
+                    heap.emplace(d, other);
+                }
+                else if (d < heap.top().first)
+                {
+                    heap.pop();
+                    heap.emplace(d, other);
+                }
+            }
+        };
+
+        // Visit rings of cells around the city until no closer city can be found
+        long long max_ring = max(cols, rows);
+        for (long long r = 0; r <= max_ring; ++r)
+        {
+            if (r == 0)
+            {
+                visit_cell(cx, cy);
+            }
+            else
+            {
+                for (long long gx = cx - r; gx <= cx + r; ++gx)
+                {
+                    visit_cell(gx, cy - r);
+                    visit_cell(gx, cy + r);
+                }
+                for (long long gy = cy - r + 1; gy <= cy + r - 1; ++gy)
+                {
+                    visit_cell(cx - r, gy);
+                    visit_cell(cx + r, gy);
+                }
+            }
+
+            // Cities in the next ring are at least r cells away
+            double reach = r * cell_size;
+            if (heap.size() == this->k && reach * reach >= heap.top().first)
+            {
+                break;
+            }
+        }
+
+        sorted.clear();
+        while (!heap.empty())
+        {
+            sorted.push_back(heap.top());
+            heap.pop();
+        }
+        reverse(sorted.begin(), sorted.end());
+
+        for (size_t n = 0; n < sorted.size(); ++n)
+        {
+            neighbors[i * this->k + n] = sorted[n].second;
+        }
+    }
+}
+
+
+CandidateLists::CandidateLists(const DistanceOracle& distances, size_t k)
+    :k(0)
+{
+    ScopedTimer timer(Phase::Preprocess);
+
+    size_t num_cities = distances.size();
+    if (num_cities < 2)
+    {
+        return;
+    }
+    this->k = min(k, num_cities - 1);
+
+    neighbors.resize(num_cities * this->k);
+
+    // Every other city by distance, the nearest k are kept in order
+    vector<pair<double, int>> others;
+    others.reserve(num_cities - 1);
+
+    distances.dispatch([&](const auto& distance) {
+        for (size_t i = 0; i < num_cities; ++i)
+        {
+            others.clear();
+            for (size_t j = 0; j < num_cities; ++j)
+            {
+                if (j != i)
+                {
+                    others.emplace_back(distance(i, j), static_cast<int>(j));
+                }
+            }
+            partial_sort(others.begin(), others.begin() + this->k, others.end());
+
+            for (size_t n = 0; n < this->k; ++n)
+            {
+                neighbors[i * this->k + n] = others[n].second;
+            }
+        }
+    });
+}
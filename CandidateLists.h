@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+
+using namespace std;
+
+class DistanceOracle;
+
+/// <summary>
+/// K-nearest-neighbour candidate lists for every city, built once per instance from a uniform grid
+/// over the node coordinates, or from the distance oracle for the metrics that are not planar. The lists
+/// are read-only after construction and shared by all particles, the tour moves only consider edges to
+/// these candidates.
+/// </summary>
+class CandidateLists {
+public:
+    // Default number of candidates per city
+    static constexpr size_t default_k = 10;
+
+    CandidateLists(const vector<pair<double, double>>& coordinates, size_t k = default_k);
+
+    /// <summary>
+    /// Lists from a full scan of the oracle, for GEO and EXPLICIT instances. O(N^2), those instances are small.
+    /// </summary>
+    CandidateLists(const DistanceOracle& distances, size_t k = default_k);
+
+    /// <summary>
+    /// Candidates of a city, ordered from the nearest to the farthest
+    /// </summary>
+    /// <param name="city"></param>
+    /// <returns></returns>
+    inline const int* begin(size_t city) const { return neighbors.data() + city * k; }
+
+    inline const int* end(size_t city) const { return neighbors.data() + (city + 1) * k; }
+
+    /// <summary>
+    /// Number of candidates per city
+    /// </summary>
+    inline size_t size() const { return k; }
+
+private:
+
+    // Filled by the instance cache
+    CandidateLists() = default;
+    friend class InstanceCache;
+
+    // Number of candidates per city
+    size_t k;
+
+    // Candidates, k entries per city
+    vector<int> neighbors;
+};
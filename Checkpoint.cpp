@@ -0,0 +1,267 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include "MappedFile.h"
+
+namespace {
+
+    // Fixed-size header at the start of the checkpoint
+    struct CheckpointHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t num_particles;
+        uint64_t num_cities;
+        uint64_t num_items;
+        uint64_t num_words;
+        uint64_t archive_size;
+        uint64_t iterations_done;
+        uint64_t stale;
+        uint64_t rng[4];
+        double capacity;
+        double v_max;
+        double v_min;
+        double rent_rate;
+        double global_best_fitness;
+        double global_best_profit;
+        double global_best_time;
+    };
+
+    const char checkpoint_magic[8] = { 'P', 'S', 'O', 'C', 'K', 'P', 'T', '\0' };
+
+    // Sections start on 8-byte boundaries
+    size_t aligned(size_t bytes)
+    {
+        return (bytes + 7) & ~static_cast<size_t>(7);
+    }
+
+    template <class T>
+    void write_section(vector<char>& buffer, const T* data, size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        size_t offset = buffer.size();
+        buffer.resize(offset + aligned(bytes), 0);
+        if (bytes > 0)
+        {
+            memcpy(buffer.data() + offset, data, bytes);
+        }
+    }
+
+    // The size of every section is checked against the file size before anything is read
+    template <class T>
+    void read_section(const char* data, size_t& offset, T* out, size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        if (bytes > 0)
+        {
+            memcpy(static_cast<void*>(out), data + offset, bytes);
+        }
+        offset += aligned(bytes);
+    }
+
+    size_t expected_size(const CheckpointHeader& h)
+    {
+        size_t tour_bytes = aligned(h.num_cities * sizeof(int));
+        size_t plan_bytes = h.num_words * sizeof(uint64_t);
+        size_t particle_bytes = 4 * sizeof(uint64_t) + sizeof(double) + 2 * (tour_bytes + plan_bytes)
+            + (h.num_cities + h.num_items) * sizeof(double);
+        return sizeof(CheckpointHeader) + tour_bytes + plan_bytes + h.archive_size * 2 * sizeof(double)
+            + h.num_particles * particle_bytes;
+    }
+}
+
+
+void Checkpoint::save(const PSO& pso, vector<char>& buffer)
+{
+    CheckpointHeader header{};
+    memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+    header.version = version;
+    header.header_size = sizeof(CheckpointHeader);
+    header.num_particles = pso.particles.size();
+    header.num_cities = pso.num_cities;
+    header.num_items = pso.num_items;
+    header.num_words = pso.global_best.second.num_words();
+    header.archive_size = pso.archive.size();
+    header.iterations_done = pso.iterations_done;
+    header.stale = pso.stale;
+    array<uint64_t, 4> rng = pso.rng.get_state();
+    memcpy(header.rng, rng.data(), sizeof(header.rng));
+    header.capacity = pso.capacity;
+    header.v_max = pso.v_max;
+    header.v_min = pso.v_min;
+    header.rent_rate = pso.rent_rate;
+    header.global_best_fitness = pso.global_best_fitness;
+    header.global_best_profit = pso.global_best_profit;
+    header.global_best_time = pso.global_best_time;
+
+    buffer.clear();
+    buffer.reserve(expected_size(header));
+    write_section(buffer, &header, 1);
+
+    // Global best and the front, ordered by travel time
+    write_section(buffer, pso.global_best.first.data(), pso.num_cities);
+    write_section(buffer, pso.global_best.second.data(), header.num_words);
+    vector<double> points;
+    points.reserve(2 * pso.archive.size());
+    for (const auto& point : pso.archive)
+    {
+        points.push_back(point.first);
+        points.push_back(point.second);
+    }
+    write_section(buffer, points.data(), points.size());
+
+    for (const auto& particle : pso.particles)
+    {
+        array<uint64_t, 4> state = particle.rng.get_state();
+        write_section(buffer, state.data(), state.size());
+        write_section(buffer, &particle.best_fitness, 1);
+        write_section(buffer, particle.tour.data(), pso.num_cities);
+        write_section(buffer, particle.picking_plan.data(), header.num_words);
+        write_section(buffer, particle.velocity.data(), pso.num_cities + pso.num_items);
+        write_section(buffer, particle.best_position.first.data(), pso.num_cities);
+        write_section(buffer, particle.best_position.second.data(), header.num_words);
+    }
+}
+
+
+bool Checkpoint::load(const string& path, PSO& pso)
+{
+    MappedFile file(path);
+    if (!file.is_open() || file.size() < sizeof(CheckpointHeader))
+    {
+        return false;
+    }
+
+    CheckpointHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, checkpoint_magic, sizeof(checkpoint_magic)) != 0 || header.version != version
+        || header.header_size != sizeof(CheckpointHeader))
+    {
+        return false;
+    }
+
+    // The checkpoint must come from a swarm of the same size on the same instance
+    if (header.num_particles != pso.particles.size() || header.num_cities != pso.num_cities
+        || header.num_items != pso.num_items || header.num_words != pso.global_best.second.num_words()
+        || header.capacity != pso.capacity || header.v_max != pso.v_max || header.v_min != pso.v_min
+        || header.rent_rate != pso.rent_rate || file.size() != expected_size(header))
+    {
+        return false;
+    }
+
+    size_t offset = aligned(sizeof(CheckpointHeader));
+    const char* data = file.data();
+
+    pso.global_best.first.resize(pso.num_cities);
+    read_section(data, offset, pso.global_best.first.data(), pso.num_cities);
+    read_section(data, offset, pso.global_best.second.data(), header.num_words);
+
+    vector<double> points(2 * header.archive_size);
+    read_section(data, offset, points.data(), points.size());
+    pso.archive.clear();
+    for (size_t i = 0; i < points.size(); i += 2)
+    {
+        pso.archive.insert(points[i], points[i + 1]);
+    }
+
+    for (auto& particle : pso.particles)
+    {
+        array<uint64_t, 4> state;
+        read_section(data, offset, state.data(), state.size());
+        particle.rng.set_state(state);
+        read_section(data, offset, &particle.best_fitness, 1);
+
+        particle.tour.resize(pso.num_cities);
+        read_section(data, offset, particle.tour.data(), pso.num_cities);
+        particle.picking_plan = PickingPlan(pso.num_items);
+        read_section(data, offset, particle.picking_plan.data(), header.num_words);
+        particle.velocity.resize(pso.num_cities + pso.num_items);
+        read_section(data, offset, particle.velocity.data(), particle.velocity.size());
+
+        particle.best_position.first.resize(pso.num_cities);
+        read_section(data, offset, particle.best_position.first.data(), pso.num_cities);
+        particle.best_position.second = PickingPlan(pso.num_items);
+        read_section(data, offset, particle.best_position.second.data(), header.num_words);
+    }
+
+    array<uint64_t, 4> rng;
+    memcpy(rng.data(), header.rng, sizeof(header.rng));
+    pso.rng.set_state(rng);
+    pso.iterations_done = header.iterations_done;
+    pso.stale = header.stale;
+    pso.global_best_fitness = header.global_best_fitness;
+    pso.global_best_profit = header.global_best_profit;
+    pso.global_best_time = header.global_best_time;
+    pso.initialised = true;
+    return true;
+}
+
+
+CheckpointWriter::CheckpointWriter(const string& path)
+    :path(path), has_pending(false), writing(false), stopping(false), written(0)
+{
+    writer = thread([this]() { writer_loop(); });
+}
+
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    wake_up.notify_all();
+    writer.join();
+}
+
+
+void CheckpointWriter::submit(vector<char>&& checkpoint)
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        pending = move(checkpoint);
+        has_pending = true;
+    }
+    wake_up.notify_all();
+}
+
+
+void CheckpointWriter::flush()
+{
+    unique_lock<mutex> lock(mtx);
+    idle.wait(lock, [this]() { return !has_pending && !writing; });
+}
+
+
+void CheckpointWriter::writer_loop()
+{
+    vector<char> checkpoint;
+    unique_lock<mutex> lock(mtx);
+    while (true)
+    {
+        wake_up.wait(lock, [this]() { return stopping || has_pending; });
+        if (!has_pending)
+        {
+            return;
+        }
+
+        checkpoint.swap(pending);
+        has_pending = false;
+        writing = true;
+        lock.unlock();
+
+        if (write_file_atomic(path, string_view(checkpoint.data(), checkpoint.size())))
+        {
+            written++;
+        }
+        else
+        {
+            cerr << "Could not write the checkpoint " << path << endl;
+        }
+
+        lock.lock();
+        writing = false;
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HelperClasses.h"
+
+using namespace std;
+
+/// <summary>
+/// Binary checkpoint of a whole swarm: the position, velocity, personal best and random stream of every
+/// particle, and the global best, front, random stream and iteration count of the swarm. A swarm restored
+/// from a checkpoint continues exactly as the swarm that wrote it would have.
+/// </summary>
+class Checkpoint {
+public:
+    static const uint32_t version = 1;
+
+    /// <summary>
+    /// Serialises the swarm into a buffer
+    /// </summary>
+    static void save(const PSO& pso, vector<char>& buffer);
+
+    /// <summary>
+    /// Restores a swarm from a checkpoint file. Returns false, leaving the swarm untouched, if the file
+    /// is missing, from another version, or written by a swarm of another size or instance.
+    /// </summary>
+    static bool load(const string& path, PSO& pso);
+};
+
+/// <summary>
+/// Writes checkpoints on a background thread, so a checkpoint costs the run only its serialisation.
+/// Every checkpoint is written to a temporary file that is renamed into place. A checkpoint submitted
+/// while an older one is still waiting replaces it.
+/// </summary>
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(const string& path);
+
+    /// <summary>
+    /// Writes the pending checkpoint, if any, and stops the writer
+    /// </summary>
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void submit(vector<char>&& checkpoint);
+
+    /// <summary>
+    /// Waits until every submitted checkpoint is written
+    /// </summary>
+    void flush();
+
+    inline size_t num_written() const { return written; }
+
+private:
+
+    void writer_loop();
+
+    string path;
+
+    mutex mtx;
+    condition_variable wake_up;
+    condition_variable idle;
+    vector<char> pending;
+    bool has_pending;
+    bool writing;
+    bool stopping;
+    atomic<size_t> written;
+
+    thread writer;
+};
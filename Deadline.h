@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+
+using namespace std;
+
+/// <summary>
+/// Wall-clock deadline of a run. A default constructed deadline never expires. Checking it reads the
+/// steady clock, so the hot loops only check it every few hundred iterations.
+/// </summary>
+class Deadline {
+public:
+    Deadline()
+        :limited(false)
+    {
+    }
+
+    /// <summary>
+    /// Deadline the given number of seconds from now
+    /// </summary>
+    explicit Deadline(double seconds)
+        :limited(true), end(chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(seconds)))
+    {
+    }
+
+    inline bool is_limited() const { return limited; }
+
+    inline bool expired() const { return limited && chrono::steady_clock::now() >= end; }
+
+    /// <summary>
+    /// Seconds left before the deadline, negative once it has passed
+    /// </summary>
+    inline double remaining() const
+    {
+        return limited ? chrono::duration<double>(end - chrono::steady_clock::now()).count() : 1e300;
+    }
+
+private:
+
+    bool limited;
+    chrono::steady_clock::time_point end;
+};
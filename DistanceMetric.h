@@ -0,0 +1,119 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+
+using namespace std;
+
+/// <summary>
+/// TSPLIB edge weight types understood by the parser. The value is stored in the metadata of the
+/// instance under "EDGE_WEIGHT_TYPE", CEIL_2D is 0 so instances without the header keep the old metric.
+/// </summary>
+enum class EdgeWeightType {
+    Ceil2D = 0,
+    Euc2D,
+    Geo,
+    Explicit
+};
+
+/// <summary>
+/// Layouts of an EDGE_WEIGHT_SECTION, stored in the metadata under "EDGE_WEIGHT_FORMAT"
+/// </summary>
+enum class EdgeWeightFormat {
+    FullMatrix = 0,
+    UpperRow,
+    LowerRow,
+    UpperDiagRow,
+    LowerDiagRow
+};
+
+/// <summary>
+/// Reads an EDGE_WEIGHT_TYPE name, returns false if the type is not supported
+/// </summary>
+inline bool parse_edge_weight_type(string_view name, EdgeWeightType& type)
+{
+    if (name == "CEIL_2D") type = EdgeWeightType::Ceil2D;
+    else if (name == "EUC_2D") type = EdgeWeightType::Euc2D;
+    else if (name == "GEO") type = EdgeWeightType::Geo;
+    else if (name == "EXPLICIT") type = EdgeWeightType::Explicit;
+    else return false;
+    return true;
+}
+
+/// <summary>
+/// Reads an EDGE_WEIGHT_FORMAT name, returns false if the format is not supported
+/// </summary>
+inline bool parse_edge_weight_format(string_view name, EdgeWeightFormat& format)
+{
+    if (name == "FULL_MATRIX") format = EdgeWeightFormat::FullMatrix;
+    else if (name == "UPPER_ROW") format = EdgeWeightFormat::UpperRow;
+    else if (name == "LOWER_ROW") format = EdgeWeightFormat::LowerRow;
+    else if (name == "UPPER_DIAG_ROW") format = EdgeWeightFormat::UpperDiagRow;
+    else if (name == "LOWER_DIAG_ROW") format = EdgeWeightFormat::LowerDiagRow;
+    else return false;
+    return true;
+}
+
+// Metric policies of the coordinate types. prepare maps a node to the coordinates the metric works on,
+// distance is the TSPLIB distance between two prepared nodes. Every TSPLIB distance is an integer.
+
+/// <summary>
+/// CEIL_2D, the Euclidean distance rounded up
+/// </summary>
+struct Ceil2DMetric {
+    static inline void prepare(double&, double&) {}
+
+    static inline int32_t distance(double x1, double y1, double x2, double y2)
+    {
+        double dx = x1 - x2;
+        double dy = y1 - y2;
+        return static_cast<int32_t>(ceil(sqrt(dx * dx + dy * dy)));
+    }
+};
+
+/// <summary>
+/// EUC_2D, the Euclidean distance rounded to the nearest integer
+/// </summary>
+struct Euc2DMetric {
+    static inline void prepare(double&, double&) {}
+
+    static inline int32_t distance(double x1, double y1, double x2, double y2)
+    {
+        double dx = x1 - x2;
+        double dy = y1 - y2;
+        return static_cast<int32_t>(sqrt(dx * dx + dy * dy) + 0.5);
+    }
+};
+
+/// <summary>
+/// GEO, the distance in kilometres on the idealised sphere between two DDD.MM latitude/longitude pairs.
+/// The coordinates are converted to radians once, when the oracle is built.
+/// </summary>
+struct GeoMetric {
+    static constexpr double pi = 3.141592;
+    static constexpr double earth_radius = 6378.388;
+
+    static inline void prepare(double& x, double& y)
+    {
+        x = radians(x);
+        y = radians(y);
+    }
+
+    static inline int32_t distance(double latitude1, double longitude1, double latitude2, double longitude2)
+    {
+        double q1 = cos(longitude1 - longitude2);
+        double q2 = cos(latitude1 - latitude2);
+        double q3 = cos(latitude1 + latitude2);
+        return static_cast<int32_t>(earth_radius * acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+    }
+
+private:
+
+    // Degrees before the point, minutes after it
+    static inline double radians(double coordinate)
+    {
+        double degrees = trunc(coordinate);
+        double minutes = coordinate - degrees;
+        return pi * (degrees + 5.0 * minutes / 3.0) / 180.0;
+    }
+};
@@ -0,0 +1,122 @@
+#include "DistanceOracle.h"
+
+#include <stdexcept>
+#include "Profiler.h"
+
+DistanceOracle::DistanceOracle(const vector<pair<double, double>>& coordinates, EdgeWeightType metric, size_t cache_budget)
+    :num_cities(coordinates.size()), metric(metric)
+{
+    ScopedTimer timer(Phase::Preprocess);
+    build_from_coordinates(coordinates, cache_budget);
+}
+
+
+DistanceOracle::DistanceOracle(const ParsedData& parsed_data, size_t cache_budget)
+    :num_cities(parsed_data.nodes.size()), metric(EdgeWeightType::Ceil2D)
+{
+    ScopedTimer timer(Phase::Preprocess);
+
+    auto header = [&](const char* key) {
+        auto it = parsed_data.metadata.find(key);
+        return it == parsed_data.metadata.end() ? 0.0 : it->second;
+    };
+
+    metric = static_cast<EdgeWeightType>(static_cast<int>(header("EDGE_WEIGHT_TYPE")));
+    if (metric != EdgeWeightType::Explicit)
+    {
+        build_from_coordinates(parsed_data.nodes, cache_budget);
+        return;
+    }
+
+    num_cities = static_cast<size_t>(header("DIMENSION"));
+    build_explicit(parsed_data.edge_weights, static_cast<EdgeWeightFormat>(static_cast<int>(header("EDGE_WEIGHT_FORMAT"))));
+}
+
+
+void DistanceOracle::build_from_coordinates(const vector<pair<double, double>>& coordinates, size_t cache_budget)
+{
+    // The metric is chosen once here, the conversion and matrix loops are specialised for it
+    switch (metric)
+    {
+    case EdgeWeightType::Euc2D:
+        build<Euc2DMetric>(coordinates, cache_budget);
+        break;
+    case EdgeWeightType::Geo:
+        build<GeoMetric>(coordinates, cache_budget);
+        break;
+    case EdgeWeightType::Explicit:
+        throw invalid_argument("An EXPLICIT instance needs its edge weights, not coordinates");
+    default:
+        build<Ceil2DMetric>(coordinates, cache_budget);
+        break;
+    }
+}
+
+
+template <class Metric>
+void DistanceOracle::build(const vector<pair<double, double>>& coordinates, size_t cache_budget)
+{
+    xs.reserve(num_cities);
+    ys.reserve(num_cities);
+
+    for (auto [x, y] : coordinates)
+    {
+        Metric::prepare(x, y);
+        xs.push_back(x);
+        ys.push_back(y);
+    }
+
+    // Keep the full matrix only if it fits in the cache budget
+    if (matrix_bytes(num_cities, false, cache_budget) == 0)
+    {
+        return;
+    }
+
+    ComputedDistances<Metric> compute{ xs.data(), ys.data() };
+    cache.resize(num_cities * num_cities, 0);
+    for (size_t i = 0; i < num_cities; ++i)
+    {
+        for (size_t j = i + 1; j < num_cities; ++j)
+        {
+            int32_t distance = static_cast<int32_t>(compute(i, j));
+            cache[i * num_cities + j] = distance;
+            cache[j * num_cities + i] = distance; // Matrix is symmetric
+        }
+    }
+}
+
+
+void DistanceOracle::build_explicit(const vector<int32_t>& edge_weights, EdgeWeightFormat format)
+{
+    cache.assign(num_cities * num_cities, 0);
+
+    // Rows of the section in order, the triangular formats are mirrored
+    size_t next = 0;
+    for (size_t i = 0; i < num_cities; ++i)
+    {
+        size_t first = 0, last = num_cities;
+        switch (format)
+        {
+        case EdgeWeightFormat::UpperRow: first = i + 1; break;
+        case EdgeWeightFormat::LowerRow: last = i; break;
+        case EdgeWeightFormat::UpperDiagRow: first = i; break;
+        case EdgeWeightFormat::LowerDiagRow: last = i + 1; break;
+        default: break;
+        }
+
+        for (size_t j = first; j < last && next < edge_weights.size(); ++j)
+        {
+            cache[i * num_cities + j] = edge_weights[next++];
+            if (format != EdgeWeightFormat::FullMatrix)
+            {
+                cache[j * num_cities + i] = cache[i * num_cities + j];
+            }
+        }
+    }
+}
+
+
+size_t DistanceOracle::memory_usage() const
+{
+    return (xs.capacity() + ys.capacity()) * sizeof(double) + cache.capacity() * sizeof(int32_t);
+}
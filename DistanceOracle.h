@@ -0,0 +1,160 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "DistanceMetric.h"
+#include "HelperFunctions.h"
+
+using namespace std;
+
+/// <summary>
+/// Distance oracle for the cities of an instance. Distances are computed on demand from the node
+/// coordinates with the metric of the instance, so memory stays O(N) even for the pla33810 instances.
+/// When the full matrix fits inside the cache budget it is precomputed once and served from memory.
+/// Every TSPLIB metric is integral, so the matrix holds 32-bit distances. EXPLICIT instances always
+/// keep their matrix.
+/// </summary>
+class DistanceOracle {
+public:
+    // Default budget for the dense cache, 64 MB keeps the a280 instances cached
+    static constexpr size_t default_cache_budget = size_t(64) << 20;
+
+    /// <summary>
+    /// Bytes of the dense matrix an oracle of num_cities cities keeps, all or nothing within the cache budget
+    /// unless the distances are explicit
+    /// </summary>
+    static inline size_t matrix_bytes(size_t num_cities, bool explicit_weights,
+        size_t cache_budget = default_cache_budget)
+    {
+        size_t bytes = num_cities * num_cities * sizeof(int32_t);
+        return explicit_weights || bytes <= cache_budget ? bytes : 0;
+    }
+
+    /// <summary>
+    /// Oracle of a planar or GEO instance, throws invalid_argument for an EXPLICIT metric
+    /// </summary>
+    DistanceOracle(const vector<pair<double, double>>& coordinates, EdgeWeightType metric = EdgeWeightType::Ceil2D,
+        size_t cache_budget = default_cache_budget);
+
+    /// <summary>
+    /// Oracle of a parsed instance, with the metric of its EDGE_WEIGHT_TYPE header
+    /// </summary>
+    explicit DistanceOracle(const ParsedData& parsed_data, size_t cache_budget = default_cache_budget);
+
+    /// <summary>
+    /// Distances read from the dense matrix
+    /// </summary>
+    struct MatrixDistances {
+        const int32_t* matrix;
+        size_t num_cities;
+
+        inline double operator()(size_t from, size_t to) const { return matrix[from * num_cities + to]; }
+    };
+
+    /// <summary>
+    /// Distances computed from the coordinates with a metric policy
+    /// </summary>
+    template <class Metric>
+    struct ComputedDistances {
+        const double* xs;
+        const double* ys;
+
+        inline double operator()(size_t from, size_t to) const
+        {
+            return Metric::distance(xs[from], ys[from], xs[to], ys[to]);
+        }
+    };
+
+    /// <summary>
+    /// Returns the distance between two cities
+    /// </summary>
+    /// <param name="from"></param>
+    /// <param name="to"></param>
+    /// <returns>double</returns>
+    inline double operator()(size_t from, size_t to) const
+    {
+        if (!cache.empty())
+        {
+            return cache[from * num_cities + to];
+        }
+
+        switch (metric)
+        {
+        case EdgeWeightType::Euc2D:
+            return ComputedDistances<Euc2DMetric>{ xs.data(), ys.data() }(from, to);
+        case EdgeWeightType::Geo:
+            return ComputedDistances<GeoMetric>{ xs.data(), ys.data() }(from, to);
+        default:
+            return ComputedDistances<Ceil2DMetric>{ xs.data(), ys.data() }(from, to);
+        }
+    }
+
+    /// <summary>
+    /// Calls the kernel with the distance source of this oracle, a MatrixDistances or a ComputedDistances
+    /// of the metric. The choice is made once per call, so a kernel written as a generic lambda runs its
+    /// loop on an inlined metric instead of branching on every distance.
+    /// </summary>
+    template <class Kernel>
+    inline auto dispatch(Kernel&& kernel) const
+    {
+        if (!cache.empty())
+        {
+            return kernel(MatrixDistances{ cache.data(), num_cities });
+        }
+
+        switch (metric)
+        {
+        case EdgeWeightType::Euc2D:
+            return kernel(ComputedDistances<Euc2DMetric>{ xs.data(), ys.data() });
+        case EdgeWeightType::Geo:
+            return kernel(ComputedDistances<GeoMetric>{ xs.data(), ys.data() });
+        default:
+            return kernel(ComputedDistances<Ceil2DMetric>{ xs.data(), ys.data() });
+        }
+    }
+
+    /// <summary>
+    /// Number of cities known to the oracle
+    /// </summary>
+    inline size_t size() const { return num_cities; }
+
+    /// <summary>
+    /// Metric of the instance
+    /// </summary>
+    inline EdgeWeightType edge_weight_type() const { return metric; }
+
+    /// <summary>
+    /// Returns true if the full distance matrix is kept in memory
+    /// </summary>
+    inline bool is_cached() const { return !cache.empty(); }
+
+    /// <summary>
+    /// Bytes used by the oracle, coordinates and cache included
+    /// </summary>
+    size_t memory_usage() const;
+
+private:
+
+    // Builds the oracle of a coordinate metric
+    void build_from_coordinates(const vector<pair<double, double>>& coordinates, size_t cache_budget);
+
+    // Converts the coordinates for the metric and fills the cache if it fits in the budget
+    template <class Metric>
+    void build(const vector<pair<double, double>>& coordinates, size_t cache_budget);
+
+    // Expands the EDGE_WEIGHT_SECTION values of an EXPLICIT instance into the full matrix
+    void build_explicit(const vector<int32_t>& edge_weights, EdgeWeightFormat format);
+
+    // Number of cities
+    size_t num_cities;
+
+    // Metric of the instance
+    EdgeWeightType metric;
+
+    // City coordinates, prepared for the metric
+    vector<double> xs, ys;
+
+    // Dense row-major distance matrix, empty if it does not fit in the budget
+    vector<int32_t> cache;
+};
@@ -0,0 +1,133 @@
+#include "GlobalBest.h"
+
+#include <algorithm>
+
+GlobalBest::GlobalBest(size_t num_readers, const pair<vector<int>, PickingPlan>& position, double fitness)
+    :current(new BestSnapshot{ position, fitness }), epoch(1), slots(new Slot[max<size_t>(1, num_readers)]),
+    num_slots(max<size_t>(1, num_readers)), published(0)
+{
+}
+
+
+GlobalBest::~GlobalBest()
+{
+    // No reader is left, everything can go
+    for (const auto& r : retired)
+    {
+        delete r.snapshot;
+    }
+    for (BestSnapshot* snapshot : spare)
+    {
+        delete snapshot;
+    }
+    delete current.load();
+}
+
+
+GlobalBest::Reader::Reader(const GlobalBest& best, size_t slot)
+    :announced(best.slots[slot].epoch)
+{
+    // Announce the epoch before loading the pointer, a snapshot replaced after this announcement
+    // is kept until the reader leaves
+    announced.store(best.epoch.load());
+    snapshot = best.current.load();
+}
+
+
+GlobalBest::Reader::~Reader()
+{
+    announced.store(0);
+}
+
+
+bool GlobalBest::publish(size_t slot, const pair<vector<int>, PickingPlan>& position, double fitness)
+{
+    // Most candidates lose against the current best, they are rejected without a copy
+    {
+        Reader best(*this, slot);
+        if (fitness <= best->fitness)
+        {
+            return false;
+        }
+    }
+
+    BestSnapshot* fresh = acquire(position, fitness);
+    BestSnapshot* replaced = nullptr;
+    {
+        // The current snapshot cannot be freed once this reader has announced its epoch
+        Reader best(*this, slot);
+        BestSnapshot* expected = current.load();
+        while (fitness > expected->fitness)
+        {
+            if (current.compare_exchange_weak(expected, fresh))
+            {
+                replaced = expected;
+                break;
+            }
+            // expected now holds the snapshot another publisher swapped in, still pinned by the epoch
+            // announced above
+        }
+    }
+
+    if (replaced == nullptr)
+    {
+        // Never published, no reader has seen it
+        lock_guard<mutex> lock(retired_mtx);
+        spare.push_back(fresh);
+        return false;
+    }
+    published.fetch_add(1);
+
+    // Readers that announced an epoch up to this one may still hold the replaced snapshot
+    lock_guard<mutex> lock(retired_mtx);
+    retired.push_back(Retired{ replaced, epoch.fetch_add(1) });
+    reclaim();
+    return true;
+}
+
+
+void GlobalBest::reclaim()
+{
+    uint64_t oldest = UINT64_MAX;
+    for (size_t s = 0; s < num_slots; ++s)
+    {
+        uint64_t announced = slots[s].epoch.load();
+        if (announced != 0)
+        {
+            oldest = min(oldest, announced);
+        }
+    }
+
+    auto kept = remove_if(retired.begin(), retired.end(), [&](const Retired& r) {
+        if (r.epoch < oldest)
+        {
+            spare.push_back(r.snapshot);
+            return true;
+        }
+        return false;
+    });
+    retired.erase(kept, retired.end());
+}
+
+
+BestSnapshot* GlobalBest::acquire(const pair<vector<int>, PickingPlan>& position, double fitness)
+{
+    BestSnapshot* snapshot = nullptr;
+    {
+        lock_guard<mutex> lock(retired_mtx);
+        if (!spare.empty())
+        {
+            snapshot = spare.back();
+            spare.pop_back();
+        }
+    }
+
+    // The copy runs outside the lock, the spare is private to this publisher now
+    if (snapshot == nullptr)
+    {
+        return new BestSnapshot{ position, fitness };
+    }
+    snapshot->position = position;
+    snapshot->fitness = fitness;
+    return snapshot;
+}
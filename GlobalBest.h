@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "PickingPlan.h"
+
+using namespace std;
+
+/// <summary>
+/// Immutable global best of an asynchronous swarm
+/// </summary>
+struct BestSnapshot {
+    pair<vector<int>, PickingPlan> position;
+    double fitness;
+};
+
+/// <summary>
+/// Global best shared by the particles of an asynchronous swarm. The current snapshot is an atomic pointer
+/// to an immutable BestSnapshot. A reader announces the current epoch in its own slot and uses the
+/// snapshot in place, it never blocks and never copies it. A publisher swaps in a new snapshot if its
+/// fitness is better, and frees the old ones once no reader slot announces an epoch older than their
+/// replacement. Freed snapshots are kept for the next publishers, which copy their position into the storage
+/// already there. Publishers serialise on a mutex for the lists of retired and spare snapshots, readers never
+/// take it.
+/// </summary>
+class GlobalBest {
+public:
+    GlobalBest(size_t num_readers, const pair<vector<int>, PickingPlan>& position, double fitness);
+
+    ~GlobalBest();
+
+    GlobalBest(const GlobalBest&) = delete;
+    GlobalBest& operator=(const GlobalBest&) = delete;
+
+    /// <summary>
+    /// Pins the current snapshot for one reader slot until it goes out of scope. A slot is used by one
+    /// thread at a time, and a reader must not publish while it holds the snapshot.
+    /// </summary>
+    class Reader {
+    public:
+        Reader(const GlobalBest& best, size_t slot);
+
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        inline const BestSnapshot& operator*() const { return *snapshot; }
+        inline const BestSnapshot* operator->() const { return snapshot; }
+
+    private:
+        atomic<uint64_t>& announced;
+        const BestSnapshot* snapshot;
+    };
+
+    inline Reader read(size_t slot) const { return Reader(*this, slot); }
+
+    /// <summary>
+    /// Publishes the position if its fitness is better than the current snapshot, from a reader slot.
+    /// Returns true if it became the global best.
+    /// </summary>
+    /// <param name="slot"></param>
+    /// <param name="position"></param>
+    /// <param name="fitness"></param>
+    bool publish(size_t slot, const pair<vector<int>, PickingPlan>& position, double fitness);
+
+    /// <summary>
+    /// Snapshots published so far, the initial one excluded
+    /// </summary>
+    inline size_t num_published() const { return published.load(); }
+
+private:
+
+    // Moves the retired snapshots no reader can still hold to the spares, with retired_mtx held
+    void reclaim();
+
+    // Spare snapshot holding the position, or a new one if there is none
+    BestSnapshot* acquire(const pair<vector<int>, PickingPlan>& position, double fitness);
+
+    // Epoch announced by a reader, 0 when the slot is idle. Every slot has its own cache line.
+    struct alignas(64) Slot {
+        atomic<uint64_t> epoch{ 0 };
+    };
+
+    struct Retired {
+        BestSnapshot* snapshot;
+        uint64_t epoch;
+    };
+
+    atomic<BestSnapshot*> current;
+    atomic<uint64_t> epoch;
+    unique_ptr<Slot[]> slots;
+    size_t num_slots;
+    atomic<size_t> published;
+
+    mutex retired_mtx;
+    vector<Retired> retired;
+    vector<BestSnapshot*> spare;
+};
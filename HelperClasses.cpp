@@ -1,153 +1,265 @@
 #include "HelperClasses.h"
 
+#include "Checkpoint.h"
+#include "GlobalBest.h"
+
 // Calculate the total distance of the TSP tour
 double PSOParticle::calculateTSPDistance(const vector<int> &new_tour)
 {
-    double totalDistance = 0.0;
+    // The loop runs on the distance source of the instance metric
+    return distances.dispatch([&](const auto& distance) {
+        double totalDistance = 0.0;
 
-    for (size_t i = 0; i < new_tour.size() - 1; i++)
-    {
-        totalDistance += distances[new_tour[i]][new_tour[i + 1]];
-    }
+        for (size_t i = 0; i < new_tour.size() - 1; i++)
+        {
+            totalDistance += distance(new_tour[i], new_tour[i + 1]);
+        }
 
-    // Add the distance to return to the starting city
-    totalDistance += distances[new_tour.back()][new_tour.front()];
-    return totalDistance;
+        // Add the distance to return to the starting city
+        totalDistance += distance(new_tour.back(), new_tour.front());
+        return totalDistance;
+    });
 }
 
 
-// Calculate the total weight of the picking plan
-double PSOParticle::calculateTotalWeight(const vector<double> &new_plan)
+// 2-OPT local search for TSP optimization, restricted to the candidate edges of every city.
+// Moves are scored in O(1) from the four affected edges and applied in place, don't-look bits
+// keep the search on the cities whose tour edges changed recently. A shorter tour can still carry the
+// picked items of the reversed segment further, so every shortening move is checked on the TTP objective
+// by the incremental evaluator, in the O(segment) time of the reversal itself.
+void PSOParticle::twoOpt()
 {
-    double totalWeight = 0.0;
-
-    for (size_t i = 0; i < new_plan.size(); i++)
+    size_t n = tour.size();
+    if (n < 4)
     {
-        if (new_plan[i] == 1)
-        {
-            totalWeight += get<2>(items[i]); // Assuming second is weight
-        }
+        return;
     }
 
-    return totalWeight;
-}
+    ScopedTimer timer(Phase::TwoOpt);
+    uint64_t tried = 0, applied = 0;
+    evaluator.build(tour, picking_plan);
 
+    // Position of every city in the tour
+    vector<size_t>& position = tour_position;
+    position.resize(n);
+    for (size_t p = 0; p < n; p++)
+    {
+        position[tour[p]] = p;
+    }
 
-// Calculate the total profit of the picking plan
-double PSOParticle::calculateKnapsackProfit(const vector<double>& new_plan)
-{
-    double totalProfit = 0.0;
+    // Queue of the cities whose don't-look bit is off, a city is queued at most once so a ring of n
+    // cities holds it
+    vector<int>& active = active_cities;
+    vector<char>& queued = queued_cities;
+    active.assign(tour.begin(), tour.end());
+    queued.assign(n, 1);
+    size_t head = 0, num_active = n;
+    size_t steps = 0;
+
+    auto wake = [&](int city) {
+        if (!queued[city])
+        {
+            queued[city] = 1;
+            active[(head + num_active) % n] = city;
+            num_active++;
+        }
+    };
 
-    for (size_t i = 0; i < new_plan.size(); i++)
+    while (num_active > 0)
     {
-        if (new_plan[i] == 1)
+        // The clock is only read every 256 cities
+        if ((++steps & 255) == 0 && deadline.expired())
         {
-            totalProfit += get<1>(items[i]); // Assuming first is profit
+            break;
         }
-    }
 
-    return totalProfit;
-}
+        int a = active[head];
+        head = (head + 1) % n;
+        num_active--;
+        queued[a] = 0;
 
+        bool improved = false;
 
-// 2-OPT local search for TSP optimization
-void PSOParticle::twoOpt()
-{
-    vector<int> bestTour = tour;
-    double bestDistance = calculateTSPDistance(bestTour);
-    bool improved = true;
-    int iteration = 0;
-    mutex mtx;
+        // Try to replace the edge to the successor (dir 0) or the predecessor (dir 1) of the city
+        for (int dir = 0; dir < 2 && !improved; dir++)
+        {
+            size_t i = position[a];
+            size_t i_next = dir == 0 ? (i + 1) % n : (i + n - 1) % n;
+            int b = tour[i_next];
+            double d_ab = distances(a, b);
 
-    while (improved) {
-        improved = false;
-        iteration++;
-        //cout << "Iteration " << iteration << ": Current Distance = " << bestDistance << endl;
+            for (const int* it = candidates.begin(a); it != candidates.end(a); ++it)
+            {
+                int c = *it;
+                double d_ac = distances(a, c);
+
+                // Candidates are sorted, no later one can give a shorter first edge
+                if (d_ac >= d_ab)
+                {
+                    break;
+                }
 
-        vector<thread> threads;
+                size_t j = position[c];
+                size_t j_next = dir == 0 ? (j + 1) % n : (j + n - 1) % n;
+                int d = tour[j_next];
+                if (c == b || d == a)
+                {
+                    continue; // Skip consecutive nodes
+                }
 
-        for (size_t i = 1; i < tour.size() - 2; i++)
-        {
-            threads.emplace_back([&, i]() {
-                for (size_t j = i + 1; j < tour.size(); j++) 
+                // Replace the edges (a, b) and (c, d) with (a, c) and (b, d)
+                double delta = d_ac + distances(b, d) - d_ab - distances(c, d);
+                tried++;
+                if (delta >= -1e-9)
                 {
-                    if (j - i == 1)
-                    {
-                        continue; // Skip consecutive nodes
-                    }
-
-                    vector<int> newTour = bestTour;
-                    reverse(newTour.begin() + i, newTour.begin() + j);
-                    double newDistance = calculateTSPDistance(newTour);
-
-                    lock_guard<mutex> lock(mtx);
-                    if (newDistance < bestDistance)
-                    {
-                        //cout << "Improvement found! Distance reduced from " << bestDistance << " to " << newDistance << endl;
-                        bestTour = newTour;
-                        bestDistance = newDistance;
-                        improved = true;
-                    }
+                    continue;
                 }
-            });
-        }
 
-        for (auto& t : threads)
-        {
-            if (t.joinable())
-            {
-                t.join();
+                // Edge e joins the cities at positions e and e + 1, reverse the tour between the two edges
+                size_t e1 = dir == 0 ? i : i_next;
+                size_t e2 = dir == 0 ? j : j_next;
+                if (e1 > e2)
+                {
+                    swap(e1, e2);
+                }
+                if (evaluator.reverse_delta(e1 + 1, e2) < 0)
+                {
+                    continue;
+                }
+                applied++;
+
+                evaluator.apply_reverse(e1 + 1, e2);
+                reverse(tour.begin() + e1 + 1, tour.begin() + e2 + 1);
+                for (size_t p = e1 + 1; p <= e2; p++)
+                {
+                    position[tour[p]] = p;
+                }
+
+                wake(a);
+                wake(b);
+                wake(c);
+                wake(d);
+                improved = true;
+                break;
             }
         }
     }
-    tour = bestTour;
+
+    Profiler::instance().add(Counter::TwoOptTried, tried);
+    Profiler::instance().add(Counter::TwoOptApplied, applied);
 }
 
-// Bit-flip local search for knapsack optimization
+// Bit-flip local search for the picking plan on the true TTP objective. Flips are screened with the O(1)
+// approximate delta of the incremental evaluator and applied best first. The approximation ignores the
+// interaction between flips, so every batch is checked with a full evaluation and halved until it improves.
+// The last single flip is checked with the exact delta, from the suffix of the tour after its city.
 void PSOParticle::bitFlipSearch()
 {
-    vector<double> bestPlan = picking_plan;
-    double bestProfit = calculateKnapsackProfit(bestPlan);
-    mutex mtx;
+    ScopedTimer timer(Phase::BitFlip);
+    uint64_t screened = 0, batches = 0, applied = 0;
 
-    vector<thread> threads;
+    const int maxPasses = 4;
+    evaluator.build(tour, picking_plan);
 
-    for (size_t i = 0; i < picking_plan.size(); i++)
+    for (int pass = 0; pass < maxPasses && !deadline.expired(); pass++)
     {
-        threads.emplace_back([&, i]() {
-            vector<double> newPlan = bestPlan;
-            newPlan[i] = 1 - newPlan[i]; // Flip the bit
+        double fitnessBefore = evaluator.fitness();
+        double weightBefore = evaluator.weight();
 
-            if (calculateTotalWeight(newPlan) <= capacity)
+        flips.clear();
+        screened += picking_plan.size() - 1;
+        for (size_t i = 1; i < picking_plan.size(); i++)
+        {
+            double delta = evaluator.flip_delta(i, picking_plan[i], true);
+            if (delta > 1e-9)
             {
-                double newProfit = calculateKnapsackProfit(newPlan);
+                flips.emplace_back(delta, i);
+            }
+        }
+
+        if (flips.empty())
+        {
+            break;
+        }
+        sort(flips.begin(), flips.end(), greater<pair<double, size_t>>());
 
-                lock_guard<mutex> lock(mtx);
-                if (newProfit > bestProfit)
+        previous_plan = picking_plan;
+        bool improved = false;
+
+        // Set while the evaluator holds the plan before the pass
+        bool current = true;
+
+        for (size_t limit = flips.size(); limit > 0 && !improved && !deadline.expired(); limit /= 2)
+        {
+            batches++;
+            if (limit == 1)
+            {
+                if (!current)
+                {
+                    evaluator.build(tour, picking_plan);
+                    current = true;
+                }
+                size_t i = flips[0].second;
+                if (evaluator.flip_delta(i, picking_plan[i], false) > 1e-9)
                 {
-                    //cout << "Improvement found! Profit increased from " << bestProfit << " to " << newProfit << endl;
-                    bestPlan = newPlan;
-                    bestProfit = newProfit;
+                    picking_plan.flip(i);
+                    evaluator.build(tour, picking_plan);
+                    improved = true;
+                    applied++;
                 }
+                continue;
             }
-        });
-    }
 
-    for (auto& t : threads)
-    {
-        if (t.joinable())
+            double currentWeight = weightBefore;
+            size_t flipped = 0;
+            for (size_t f = 0; f < limit; f++)
+            {
+                size_t i = flips[f].second;
+                bool picked = picking_plan[i];
+                int weight = items.weight(i);
+                if (!picked && currentWeight + weight > capacity)
+                {
+                    continue;
+                }
+
+                picking_plan.flip(i);
+                currentWeight += picked ? -weight : weight;
+                flipped++;
+            }
+
+            evaluator.build(tour, picking_plan);
+            improved = evaluator.fitness() > fitnessBefore;
+            if (improved)
+            {
+                applied += flipped;
+            }
+            else
+            {
+                picking_plan = previous_plan;
+                current = false;
+            }
+        }
+
+        if (!improved)
         {
-            t.join();
+            if (!current)
+            {
+                evaluator.build(tour, picking_plan);
+            }
+            break;
         }
     }
 
-    picking_plan = bestPlan;
+    Profiler& profiler = Profiler::instance();
+    profiler.add(Counter::BitFlipScreened, screened);
+    profiler.add(Counter::BitFlipBatches, batches);
+    profiler.add(Counter::BitFlipApplied, applied);
 }
 
 // Restrictive local search combining 2-OPT and bit-flip search
 void PSOParticle::restrictiveLocalSearch(int maxIterations)
 {
-    for (int iteration = 0; iteration < maxIterations; iteration++)
+    for (int iteration = 0; iteration < maxIterations && !deadline.expired(); iteration++)
     {
         //cout << "Restrictive Local Search Iteration " << iteration + 1 << endl;
         twoOpt(); // Optimize the TSP tour
@@ -155,20 +267,27 @@ void PSOParticle::restrictiveLocalSearch(int maxIterations)
     }
 }
 
-void PSOParticle::prioritise_items()
+// Deep local search combining the Or-opt/Lin-Kernighan tour engine and bit-flip search
+void PSOParticle::deepLocalSearch()
 {
-    for (auto& [city, item_list] : items_dict)
+    engine.optimise(tour, deadline); // Optimize the TSP tour
+    bitFlipSearch(); // Optimize the picking plan
+}
+
+void PSOParticle::localSearch()
+{
+    ScopedTimer timer(Phase::LocalSearch);
+
+    // The searches keep the plan within the capacity, a plan over it is repaired first
+    evaluator.repair(tour, picking_plan);
+
+    if (local_search == LocalSearchMode::Deep)
     {
-        // Sort items in a temporary vector
-        vector<item> sorted_items = item_list;
-        sort(sorted_items.begin(), sorted_items.end(), 
-            [](const item& a, const item& b) {
-            return ((a.profit) / static_cast<double>((a.weight))) >
-                ((b.profit) / static_cast<double>((b.weight)));
-            });
-
-        // Replace the unordered_map value with the sorted vector
-        items_dict[city] = sorted_items;
+        deepLocalSearch();
+    }
+    else
+    {
+        restrictiveLocalSearch();
     }
 }
 
@@ -177,33 +296,29 @@ void PSOParticle::prioritise_items()
 //------------------------------------------------------------------------------------------------------------------------
 // PSOParticle class
 //------------------------------------------------------------------------------------------------------------------------
-PSOParticle::PSOParticle(const vector<vector<double>>& distances, const vector<tuple<int, int, int, int>>& items,
-    int num_cities, int num_items, double capacity, double v_max, double v_min, double rent_rate)
-    :distances(distances), items(items), num_cities(num_cities), num_items(num_items), capacity(capacity), v_max(v_max),
-    v_min(v_min), rent_rate(rent_rate)
+PSOParticle::PSOParticle(const InstanceContext& context, int num_cities, int num_items, double capacity, double v_max, double v_min, double rent_rate,
+    const Xoshiro256& rng, const Deadline& deadline, LocalSearchMode local_search)
+    :context(context), distances(context.distances()), candidates(context.candidates()), items(context.items()), num_cities(num_cities), num_items(num_items), best_fitness(-1e9),
+    capacity(capacity), v_max(v_max), v_min(v_min), rent_rate(rent_rate), local_search(local_search),
+    evaluator(context.distances(), context.items(), capacity, rent_rate, v_max, v_min), rng(rng), deadline(deadline),
+    engine(context.distances(), context.candidates())
 {
-    // Instantiate the items dictionary, with key as assigned node or city
-    for (const auto &i : items)
-    {
-        items_dict[get<3>(i)].push_back(item{ get<0>(i), get<1>(i), get<2>(i) });
-        //items_dict[get<3>(item)].push_back({ get<0>(item), get<1>(item), get<2>(item) });
-    }
+}
 
-    prioritise_items();
 
+void PSOParticle::initialise()
+{
     // Initialise the tour vector
     tour = vector<int>(num_cities, 0);
     iota(tour.begin(), tour.end(), 0);
-    // Use a random number generator
-    random_device rd;
-    mt19937 g(rd()); // Mersenne Twister engine
-    shuffle(tour.begin(), tour.end(), g); // Shuffle tour starting from the first element
+    // Shuffle tour starting from the first element, with the particle's random stream
+    shuffle(tour.begin(), tour.end(), rng);
     
     // Initialise the picking plan
-    picking_plan.resize(num_items, 0);
+    picking_plan = PickingPlan(num_items);
     generate_valid_picking_plan();
 
-    restrictiveLocalSearch();
+    localSearch();
 
     // Initialise the velocity that is the tour and picking plan
     velocity = vector<double>(num_cities + num_items, 0.0);
@@ -216,50 +331,38 @@ PSOParticle::PSOParticle(const vector<vector<double>>& distances, const vector<t
 
 void PSOParticle::generate_valid_picking_plan()
 {
-    // Generate a random number using uniform distribution
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<> dis(0.0, 1.0);
-    
     double current_weight = 0;
 
     // Loop over the tour
     //for (auto city = tour.rbegin(); city != tour.rend(); ++city)
     //{
     //    // Loop over the items in the current city
-    //    for (const auto &item : items_dict[*city])
+    //    for (const int* item = items.city_begin(*city); item != items.city_end(*city); ++item)
     //    {
     //        // Random value generator
-    //        double r = dis(gen);
+    //        double r = rng.uniform();
     //        const double r_check = 0.3;
 
     //        // Pick the item if the weight of current item and knapsack weight is less than the capacity
-    //        if (r > r_check && current_weight + item.weight <= capacity)
+    //        if (r > r_check && current_weight + items.weight(*item) <= capacity)
     //        {
     //            // Add the item to picking plan and add to current weight
-    //            picking_plan[item.index] = 1;
-    //            current_weight += item.weight;
+    //            picking_plan.set(*item, true);
+    //            current_weight += items.weight(*item);
     //        }
     //    }
     //}
 
-    vector<tuple<int, int, int, int>> items_sort = items;
-
-    sort(items_sort.begin() + 1, items_sort.end(),
-        [](const tuple<int, int, int, int>& a, const tuple<int, int, int, int>& b) {
-        return (static_cast<double>(get<1>(a)) / static_cast<double>(get<2>(a))) >
-            (static_cast<double>(get<1>(b)) / static_cast<double>(get<2>(b)));
-        });
-
-    for (auto& it : items_sort)
+    // Items by profit/weight, sorted once for the instance
+    for (int it : context.packing_order())
     {
         // Random value generator
-        double r = dis(gen);
+        double r = rng.uniform();
         const double r_check = 0.3;
-        if (r > r_check && current_weight + get<2>(it) <= capacity)
+        if (r > r_check && current_weight + items.weight(it) <= capacity)
         {
-            picking_plan[get<0>(it)] = 1;
-            current_weight += get<2>(it);
+            picking_plan.set(it, true);
+            current_weight += items.weight(it);
         }
     }
 
@@ -274,73 +377,43 @@ double PSOParticle::calculate_speed(double current_weight) const
 }
 
 
-return_values PSOParticle::evaluate_fitness(const vector<vector<double>>& distances, const vector<tuple<int, int, int, int>>& items,
+return_values PSOParticle::evaluate_fitness(const DistanceOracle& distances, const ItemStore& items,
     double capacity, double rent_rate, double v_max, double v_min)
 {
-    // Initialise the total profit, travel time and current weight for the tour
-    double total_profit = 0;
-    double travel_time = 0;
-    double current_weight = 0;
-
-    for (size_t i = 0; i < tour.size(); ++i)
-    {
-        // Get the current city
-        size_t current_city = tour[i];
-
-        // Get the next city in tour
-        size_t next_city = tour[(i + 1) % tour.size()];
-
-        // Calculate distance to next city
-        double distance = distances[current_city][next_city];
-
-        // Update weight and profit based on picking plan
-        for (const auto& item : items_dict[current_city])
-        {
-            // Check if item is in the picking plan and if the current weight of the knapsack is less than the capacity
-            if (picking_plan[item.index] == 1 && current_weight + item.weight <= capacity)
-            {
-                // Add the current weight of item to current knapsack weight
-                current_weight += item.weight;
-
-                // Add the value of item to the total profit of knapsack
-                total_profit += item.profit;
-            }
-        }
-
-        // Calculate the speed from the current knapsack weight
-        double speed = calculate_speed(current_weight);
-
-        // Add the travel time between cities to the total travel time
-        travel_time += distance / speed;
-    }
+    return record_fitness(BatchEvaluator(distances, items, capacity, rent_rate, v_max, v_min).evaluate(tour, picking_plan));
+}
 
-    // Calculate fitness using total profit, rent rate and travel time
-    double fitness = total_profit - rent_rate * travel_time;
 
-    // Update the fitness and position, if the current fitness is greater than the best fitness
-    if (fitness > best_fitness)
+return_values PSOParticle::record_fitness(const FitnessValues& values)
+{
+    // Update the fitness and position, if the current fitness is greater than the best fitness. The
+    // position is copied into the storage of the old best, which has the same size.
+    if (values.fitness > best_fitness)
     {
-        best_fitness = fitness;
-        best_position = { tour, picking_plan };
+        best_fitness = values.fitness;
+        best_position.first = tour;
+        best_position.second = picking_plan;
     }
 
     // Return the best fitness, profit, current weight of knapsack and travel time
-    return return_values{ best_fitness, total_profit, current_weight, travel_time };
+    return return_values{ best_fitness, values.profit, values.weight, values.time };
 }
 
 
-void PSOParticle::update_position(const pair<vector<int>, vector<double>>& global_best, double w, double c1, double c2)
+void PSOParticle::update_position(const pair<vector<int>, PickingPlan>& global_best, double w, double c1, double c2)
 {
-    // Generate a random number using uniform distribution
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<> dis(0.0, 1.0);
+    Profiler::instance().add(Counter::PositionUpdates);
+
+    // Draw the two random numbers of every city and item in one batch
+    random_values.resize(2 * (tour.size() + picking_plan.size()));
+    rng.fill_uniform(random_values.data(), random_values.size());
+    const double* r = random_values.data();
 
     for (size_t i = 0; i < tour.size(); ++i)
     {
-        // Generate random numbers
-        double r1 = RandomFloat(0,1);
-        double r2 = RandomFloat(0, 1);
+        // Random numbers of the city
+        double r1 = *r++;
+        double r2 = *r++;
 
         // Calculate the first part of velocity that is the tour using the personal best and global best positions
         velocity[i] = w * velocity[i] +
@@ -352,121 +425,271 @@ void PSOParticle::update_position(const pair<vector<int>, vector<double>>& globa
 
     for (size_t i = 0; i < picking_plan.size(); ++i)
     {
-        double r1 = RandomFloat(0, 1);
-        double r2 = RandomFloat(0, 1);
+        double r1 = *r++;
+        double r2 = *r++;
 
         // Calculate the second part of velocity that is the picking plan using the personal best and global best positions
         velocity[tour.size()-1 + i] = w * velocity[tour.size() + i] +
                                     c1 * r1 * (best_position.second[i] - picking_plan[i]) +
                                     c2 * r2 * (global_best.second[i] - picking_plan[i]);
 
-        picking_plan[i] = (1 / (1 + exp(-velocity[tour.size() + i]))) > 0.5 ? 1 : 0;
+        picking_plan.set(i, (1 / (1 + exp(-velocity[tour.size() + i]))) > 0.5);
     }
 }
 
+void PSOParticle::set_position(const vector<int>& new_tour, const PickingPlan& new_plan)
+{
+    tour = new_tour;
+    picking_plan = new_plan;
+    fill(velocity.begin(), velocity.end(), 0.0);
+}
+
 //------------------------------------------------------------------------------------------------------------------------
 // PSO class
 //------------------------------------------------------------------------------------------------------------------------
 
-PSO::PSO(size_t num_particles, const vector<vector<double>>& distances, const vector<tuple<int, int, int, int>>& items, 
-    size_t num_cities, size_t num_items, double capacity, double v_max, double v_min, double rent_rate)
-    :num_particles(num_particles), distances(distances), items(items), num_cities(num_cities), num_items(num_items), 
-    capacity(capacity), v_max(v_max), v_min(v_min), rent_rate(rent_rate)
+PSO::PSO(size_t num_particles, const InstanceContext& context, size_t num_cities, size_t num_items, double capacity, double v_max, double v_min, double rent_rate, LocalSearchMode local_search,
+    uint64_t seed, const Deadline& deadline, ThreadPool& pool)
+    :improved(false), stale(0), initialised(false), iterations_done(0), checkpoint_interval(0), pool(pool), deadline(deadline), context(context), distances(context.distances()), items(context.items()),
+    evaluator(context.distances(), context.items(), capacity, rent_rate, v_max, v_min), num_particles(num_particles), num_cities(num_cities), num_items(num_items),
+    capacity(capacity), v_max(v_max), v_min(v_min), rent_rate(rent_rate), local_search(local_search), rng(seed)
 {
     // Initialise the global best fitness, profit and time
     global_best_fitness = -1e9;
     global_best_profit = -1e9;
     global_best_time = -1e9;
 
-    // Initialise the PSOParticles
+    // Create the PSOParticles, each with its own random stream split in order from the seed
+    particles.reserve(num_particles);
     for (size_t i = 0; i < num_particles; ++i)
     {
-        particles.emplace_back(distances, items, num_cities, num_items, capacity, v_max, v_min, rent_rate);
+        particles.emplace_back(context, num_cities, num_items, capacity, v_max, v_min, rent_rate,
+            rng.split(), this->deadline, local_search);
     }
 
     // Initialise the global best
-    global_best = {vector<int>(num_cities, 0), vector<double>(num_items, 0.0)};
+    global_best = {vector<int>(num_cities, 0), PickingPlan(num_items)};
+}
+
+
+PSO::~PSO()
+{
+    // Defined here, where the checkpoint writer is a complete type. It finishes its pending write.
+}
+
+
+void PSO::initialise_particles()
+{
+    // Build the initial tours and picking plans and run the local search of all particles in parallel,
+    // a particle only draws from its own stream so the swarm does not depend on the scheduling
+    ScopedTimer timer(Phase::Initialise);
+    pool.parallel_for(0, particles.size(), [&](size_t i) {
+        particles[i].initialise();
+    });
+    initialised = true;
+}
+
+
+void PSO::enable_checkpoints(const string& path, size_t interval)
+{
+    checkpoint_writer = interval > 0 ? make_unique<CheckpointWriter>(path) : nullptr;
+    checkpoint_interval = interval;
 }
 
 
 void PSO::update_particle_position(double w, double c1, double c2)
 {
-    // Vector of threads
-    vector<thread> threads;
+    ScopedTimer timer(Phase::Update);
+
+    // Update the particle positions in parallel on the thread pool
+    pool.parallel_for(0, particles.size(), [&](size_t i) {
+        particles[i].update_position(global_best, w, c1, c2);
+    });
+}
+
+
+void PSO::evaluate_particle_fitness()
+{
+    ScopedTimer timer(Phase::Evaluate);
 
-    // Loop over all the particles
-    for (auto& particle : particles)
+    // Score the whole swarm in one batch on the thread pool
+    batch.clear();
+    for (const auto& particle : particles)
     {
-        // Initialise the threads to update the particle position
-        threads.emplace_back([&]() { particle.update_position(global_best, w, c1, c2); });
+        batch.push_back(particle.candidate());
     }
+    evaluator.evaluate(batch, batch_values, pool);
 
-    // Loop over all the threads
-    for (auto& thread : threads)
+    // Fold the results in particle order, so the global best and archive do not depend on the scheduling.
+    // Only the last particle that improves the global best has its position copied.
+    size_t best_particle = particles.size();
+    for (size_t i = 0; i < particles.size(); ++i)
     {
-        // Check if the thread is joinable
-        if (thread.joinable())
+        auto values = particles[i].record_fitness(batch_values[i]);
+
+        if (values.fitness > global_best_fitness)
+        {
+            global_best_fitness = values.fitness;
+            best_particle = i;
+            improved = true;
+        }
+
+        // Every evaluated particle is a candidate for the front
+        if (archive.insert(values.time, values.profit))
         {
-            // Join or wait for the thread execution
-            thread.join();
+            improved = true;
         }
     }
+
+    // Copied into the storage of the old global best, which has the same size
+    if (best_particle < particles.size())
+    {
+        global_best = particles[best_particle].get_best_position();
+    }
 }
 
 
-void PSO::evaluate_particle_fitness(double w, double c1, double c2)
+void PSO::check_stop_condition(const char* caller, size_t iterations, size_t stagnation) const
 {
-    // Vector of threads
-    vector<thread> threads;
+    // Without an iteration count, deadline or stagnation limit the run would never end
+    if (iterations == 0 && stagnation == 0 && !deadline.is_limited())
+    {
+        throw invalid_argument(string(caller) + " needs an iteration count, a deadline or a stagnation limit");
+    }
+}
 
-    // Loop over all the particles
-    for (auto& particle : particles)
+
+const ParetoArchive& PSO::run(size_t iterations, double w, double c1, double c2, size_t stagnation)
+{
+    check_stop_condition("PSO::run", iterations, stagnation);
+
+    if (!initialised)
     {
-        // Initialise the threads to evaluate the fitness of particles
-        threads.emplace_back([&]() {
-            auto values = particle.evaluate_fitness(distances, items, capacity, rent_rate, v_max, v_min);
-
-            // Add lock guard to protect the shared data, travel time and profit list
-            lock_guard<mutex> lock(mtx);
-            
-            if (values.fitness > global_best_fitness)
+        initialise_particles();
+    }
+
+    ScopedTimer timer(Phase::Run);
+
+    // Loop for number of 'iterations', 0 loops until the deadline or stagnation. The swarm is always
+    // evaluated once, so the front holds the initial particles even if they used up the whole budget.
+    for (size_t iter = 0; iterations == 0 || iter < iterations; ++iter)
+    {
+        // Evaluate the particle fitness
+        improved = false;
+        evaluate_particle_fitness();
+
+        stale = improved ? 0 : stale + 1;
+        if ((stagnation > 0 && stale >= stagnation) || deadline.expired())
+        {
+            break;
+        }
+
+        // Update the particle position
+        update_particle_position(w, c1, c2);
+        iterations_done++;
+
+        // Hand a snapshot of the swarm to the background writer, the last iteration of the run needs none
+        if (checkpoint_writer && iterations_done % checkpoint_interval == 0 && iter + 1 != iterations)
+        {
+            ScopedTimer checkpoint_timer(Phase::Checkpoint);
+            vector<char> snapshot;
+            Checkpoint::save(*this, snapshot);
+            checkpoint_writer->submit(move(snapshot));
+        }
+    }
+
+    // Return the front of travel times and profits
+    return archive;
+}
+
+
+const ParetoArchive& PSO::run_async(size_t iterations, double w, double c1, double c2, size_t stagnation)
+{
+    check_stop_condition("PSO::run_async", iterations, stagnation);
+
+    if (!initialised)
+    {
+        initialise_particles();
+    }
+
+    ScopedTimer timer(Phase::Run);
+
+    // The particles share the global best through snapshots, every particle reads with its own slot
+    GlobalBest best(particles.size(), global_best, global_best_fitness);
+    vector<ParetoArchive> fronts(particles.size());
+    vector<size_t> completed(particles.size(), 0);
+    vector<size_t> particle_stale(particles.size(), stale);
+
+    // The evaluations and moves of a particle interleave with those of the others, so the loop is timed once
+    // as a whole, as the evaluate phase, instead of per particle and iteration
+    {
+        ScopedTimer loop_timer(Phase::Evaluate);
+        pool.parallel_for(0, particles.size(), [&](size_t i) {
+            PSOParticle& particle = particles[i];
+            const BatchCandidate position = particle.candidate();
+
+            for (size_t iter = 0; iterations == 0 || iter < iterations; ++iter)
             {
-                global_best_fitness = values.fitness;
-                global_best = particle.get_best_position();
-                
-                // Push the values in the list after execution
-                travel_time_list.push_back(values.time);
-                profit_list.push_back(values.profit);
-            }
+                return_values values = particle.record_fitness(evaluator.evaluate(*position.tour, *position.plan));
+
+                bool gained = fronts[i].insert(values.time, values.profit);
+
+                // Only a likely improvement pays for the copy of the personal best. The reader is released before
+                // publishing, a temporary in the condition would hold its epoch across the publish.
+                double published_fitness = best.read(i)->fitness;
+                if (values.fitness > published_fitness && best.publish(i, particle.get_best_position(), values.fitness))
+                {
+                    gained = true;
+                }
+
+                particle_stale[i] = gained ? 0 : particle_stale[i] + 1;
+                if ((stagnation > 0 && particle_stale[i] >= stagnation) || deadline.expired())
+                {
+                    break;
+                }
 
+                // Move towards the latest published best, in place
+                {
+                    GlobalBest::Reader global = best.read(i);
+                    particle.update_position(global->position, w, c1, c2);
+                }
+                completed[i]++;
+            }
         });
     }
 
-    // Loop over all the threads
-    for (auto& thread : threads)
+    // Merge the fronts of the particles and keep the last published best
+    for (const auto& front : fronts)
     {
-        // Check if the thread is joinable
-        if (thread.joinable())
+        archive.merge(front);
+    }
+    {
+        GlobalBest::Reader final_best = best.read(0);
+        if (final_best->fitness > global_best_fitness)
         {
-            // Join or wait for the thread execution
-            thread.join();
+            global_best = final_best->position;
+            global_best_fitness = final_best->fitness;
         }
     }
+    if (!particles.empty())
+    {
+        stale = *min_element(particle_stale.begin(), particle_stale.end());
+        iterations_done += *max_element(completed.begin(), completed.end());
+    }
+
+    return archive;
 }
 
 
-tuple<vector<double>, vector<double>> PSO::run(size_t iterations, double w, double c1, double c2)
+void PSO::inject(const vector<int>& tour, const PickingPlan& plan)
 {
-    // Loop for number of 'iterations'
-    for (size_t iter = 0; iter < iterations; ++iter)
+    if (particles.empty() || tour.size() != num_cities || plan.size() != num_items)
     {
-        // Evaluate the particle fitness
-        evaluate_particle_fitness(w, c1, c2);
-
-        // Update the particle position
-        update_particle_position(w, c1, c2);        
+        return;
     }
 
-    // Return the travel time and profit lists
-    return { travel_time_list, profit_list };
+    auto worst = min_element(particles.begin(), particles.end(), [](const PSOParticle& a, const PSOParticle& b) {
+        return a.get_best_fitness() < b.get_best_fitness();
+    });
+    worst->set_position(tour, plan);
 }
\ No newline at end of file
@@ -3,27 +3,50 @@
 #include <mutex>
 #include <numeric>
 #include <random>
+#include <stdexcept>
 #include <thread>
-#include <unordered_map>
 #include <vector>
 
+#include "BatchEvaluator.h"
+#include "CandidateLists.h"
+#include "Deadline.h"
+#include "DistanceOracle.h"
 #include "HelperFunctions.h"
+#include "InstanceContext.h"
+#include "ItemStore.h"
+#include "ParetoArchive.h"
+#include "PickingPlan.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "ThreadPool.h"
+#include "TourEngine.h"
+#include "TTPEvaluator.h"
 
 using namespace std;
 
+class CheckpointWriter;
+
 struct return_values {
-    double fitness, profit, weight, time, best_profit;
+    double fitness, profit, weight, time;
 };
 
-struct item {
-    int index, profit, weight;
+// Local search run on the particles, 2-OPT with bit-flip or the deeper Or-opt/Lin-Kernighan tour engine
+enum class LocalSearchMode {
+    Restrictive,
+    Deep
 };
 
 // Class for a PSO Particle
 class PSOParticle {
 public:
-    PSOParticle(const vector<vector<double>>& distances, const vector<tuple<int, int, int, int>>& items,
-        int num_cities, int num_items, double capacity, double v_max, double v_min, double rent_rate);
+    PSOParticle(const InstanceContext& context, int num_cities, int num_items, double capacity, double v_max, double v_min, double rent_rate,
+        const Xoshiro256& rng, const Deadline& deadline, LocalSearchMode local_search = LocalSearchMode::Restrictive);
+
+    /// <summary>
+    /// Builds the random initial tour and a valid picking plan and runs the local search on them.
+    /// The constructor only stores the parameters, so the particles of a swarm can be initialised in parallel.
+    /// </summary>
+    void initialise();
 
     /// <summary>
     /// Evaluate the fitness of the particle or solution based on objective function that includes total profit, rent rate and travel time.
@@ -35,9 +58,21 @@ public:
     /// <param name="v_max"></param>
     /// <param name="v_min"></param>
     /// <returns></returns>
-    return_values evaluate_fitness(const vector<vector<double>>& distances, const vector<tuple<int, int, int, int>>& items,
+    return_values evaluate_fitness(const DistanceOracle& distances, const ItemStore& items,
         double capacity, double rent_rate, double v_max, double v_min);
 
+    /// <summary>
+    /// Records the objective of the current position, scored by a batch evaluator, and updates the personal best
+    /// </summary>
+    /// <param name="values"></param>
+    /// <returns>The best fitness and the profit, weight and travel time of the current position</returns>
+    return_values record_fitness(const FitnessValues& values);
+
+    /// <summary>
+    /// Current tour and picking plan, for a batch evaluation
+    /// </summary>
+    inline BatchCandidate candidate() const { return BatchCandidate{ &tour, &picking_plan }; }
+
     /// <summary>
     /// Updates the position of the particle based on the personal and global best.
     /// c1 and c2 are the acceleration coefficients to determine the influence of personal and global best solutions.
@@ -46,20 +81,31 @@ public:
     /// <param name="w"></param>
     /// <param name="c1"></param>
     /// <param name="c2"></param>
-    void update_position(const pair<vector<int>, vector<double>>& global_best, double w, double c1, double c2);
+    void update_position(const pair<vector<int>, PickingPlan>& global_best, double w, double c1, double c2);
 
     /// <summary>
-    /// Returns the best position, that is the tour and picking plan
+    /// Returns the best position, that is the tour and picking plan. The reference stays valid, the
+    /// position is updated in place when the particle improves.
     /// </summary>
     /// <returns></returns>
-    inline pair<vector<int>, vector<double>> get_best_position() const { return best_position; }
+    inline const pair<vector<int>, PickingPlan>& get_best_position() const { return best_position; }
 
-private:
+    inline double get_best_fitness() const { return best_fitness; }
 
     /// <summary>
-    /// Prioritise the items with higher profit/weight in any city
+    /// Moves the particle to the given tour and picking plan and stops it, the next evaluation scores it
     /// </summary>
-    void prioritise_items();
+    /// <param name="new_tour"></param>
+    /// <param name="new_plan"></param>
+    void set_position(const vector<int>& new_tour, const PickingPlan& new_plan);
+
+private:
+
+    // Gives the benchmark access to the kernels below
+    friend class ParticleKernels;
+
+    // Saves and restores the state of the particle
+    friend class Checkpoint;
 
     void twoOpt();
 
@@ -67,11 +113,18 @@ private:
 
     void restrictiveLocalSearch(int maxIterations = 2);
 
-    double calculateTSPDistance(const vector<int> &new_tour);
+    /// <summary>
+    /// Alternative to the restrictive local search, improves the tour with Or-opt and Lin-Kernighan style
+    /// moves on a two-level list, then runs the bit-flip search on the picking plan.
+    /// </summary>
+    void deepLocalSearch();
 
-    double calculateTotalWeight(const vector<double> &new_plan);
+    /// <summary>
+    /// Runs the local search selected for the particle
+    /// </summary>
+    void localSearch();
 
-    double calculateKnapsackProfit(const vector<double> &new_plan);
+    double calculateTSPDistance(const vector<int> &new_tour);
 
     /// <summary>
     /// Generates a valid picking plan based on the knapsack capacity.
@@ -85,17 +138,20 @@ private:
     /// <returns>double</returns>
     double calculate_speed(double current_weight) const;
 
-    // Distances matrix, contains distances between all the cities
-    const vector<vector<double>>& distances;
+    // Preprocessing of the instance shared by all particles, with the packing order of the items
+    const InstanceContext& context;
 
-    //Items vector, contains index, profit, weight and assigned node
-    const vector<tuple<int, int, int, int>>& items;
+    // Distance oracle, gives the distance between any two cities
+    const DistanceOracle& distances;
+
+    // Nearest neighbour candidates of every city, shared by all particles
+    const CandidateLists& candidates;
+
+    // Item store, with the profit, weight and assigned node of every item and the items of every city
+    const ItemStore& items;
 
-    // Items dictionary, with key as the node and values as index, profit and weight
-    unordered_map<size_t, vector<item>> items_dict;
-    
     // Best position of the particle, that is the tour and the picking plan
-    pair<vector<int>, vector<double>> best_position;
+    pair<vector<int>, PickingPlan> best_position;
 
     // Number of cities
     int num_cities;
@@ -106,8 +162,8 @@ private:
     // Current tour
     vector<int> tour;
 
-    // Picking plan for items
-    vector<double> picking_plan;
+    // Picking plan for items, one bit per item
+    PickingPlan picking_plan;
 
     // Velocity, that is tour and picking plan
     vector<double> velocity;
@@ -126,6 +182,33 @@ private:
 
     // Rent rate
     double rent_rate;
+
+    // Local search run on the particle
+    LocalSearchMode local_search;
+
+    // Incremental evaluator of the TTP objective used by the local search
+    TTPEvaluator evaluator;
+
+    // Random stream of the particle, split from the swarm's seed
+    Xoshiro256 rng;
+
+    // Deadline of the run, the local searches stop early when it expires
+    const Deadline& deadline;
+
+    // Uniform random numbers drawn in one batch for every position update
+    vector<double> random_values;
+
+    // Scratch of the local searches, kept between calls so a search only allocates while they grow.
+    // 2-OPT: position of every city in the tour, ring buffer of the cities whose don't-look bit is off
+    // and the bits themselves. Bit-flip: screened flips and the plan before a batch of flips.
+    vector<size_t> tour_position;
+    vector<int> active_cities;
+    vector<char> queued_cities;
+    vector<pair<double, size_t>> flips;
+    PickingPlan previous_plan;
+
+    // Or-opt/Lin-Kernighan engine of the deep local search, it keeps its queue between calls
+    TourEngine engine;
 };
 
 
@@ -134,35 +217,113 @@ private:
 /// </summary>
 class PSO {
 public:
-    PSO(size_t num_particles, const vector<vector<double>>& distances,
-        const vector<tuple<int, int, int, int>>& items, size_t num_cities, size_t num_items, double capacity,
-        double v_max, double v_min, double rent_rate);
+    PSO(size_t num_particles, const InstanceContext& context, size_t num_cities, size_t num_items, double capacity,
+        double v_max, double v_min, double rent_rate, LocalSearchMode local_search = LocalSearchMode::Restrictive,
+        uint64_t seed = master_seed(), const Deadline& deadline = Deadline(), ThreadPool& pool = ThreadPool::instance());
+
+    ~PSO();
 
     /// <summary>
-    /// Runs Particle Swarm Optimisation algorithm
+    /// Runs Particle Swarm Optimisation algorithm, until the number of iterations is reached, the deadline
+    /// of the swarm expires or the front and best fitness have not improved for 'stagnation' iterations.
+    /// An iteration count of 0 runs until the deadline or stagnation, and a stagnation of 0 disables it.
+    /// The best solution and front found so far are kept when the run stops early. Throws invalid_argument
+    /// if none of the three can stop the run.
     /// </summary>
     /// <param name="iterations"></param>
     /// <param name="w"></param>
     /// <param name="c1"></param>
     /// <param name="c2"></param>
+    /// <param name="stagnation"></param>
     /// <param name="distances"></param>
     /// <param name="items"></param>
     /// <param name="capacity"></param>
     /// <param name="rent_rate"></param>
     /// <param name="v_max"></param>
     /// <param name="v_min"></param>
-    /// <returns></returns>
-    tuple<vector<double>, vector<double>> run(size_t iterations, double w, double c1, double c2);
-
-private:
+    /// <returns>Non-dominated front of the travel times and profits of all evaluated particles</returns>
+    const ParetoArchive& run(size_t iterations, double w, double c1, double c2, size_t stagnation = 0);
 
     /// <summary>
-    /// Evaluate the particle fitness
+    /// Asynchronous variant of run. Every particle loops on its own: it evaluates itself, publishes an
+    /// improvement of the global best and moves towards the latest published best, without waiting for the
+    /// other particles. A particle stops after 'iterations' iterations, at the deadline, or when it has not
+    /// improved the global best or its own front for 'stagnation' iterations. The fronts of the particles
+    /// are merged at the end. With more than one thread the result depends on the scheduling, and no
+    /// checkpoints are written. Throws invalid_argument if nothing can stop the run, as run does.
     /// </summary>
+    /// <param name="iterations"></param>
     /// <param name="w"></param>
     /// <param name="c1"></param>
     /// <param name="c2"></param>
-    void evaluate_particle_fitness(double w, double c1, double c2);
+    /// <param name="stagnation"></param>
+    /// <returns>Non-dominated front of the travel times and profits of all evaluated particles</returns>
+    const ParetoArchive& run_async(size_t iterations, double w, double c1, double c2, size_t stagnation = 0);
+
+    /// <summary>
+    /// Best tour and picking plan found so far
+    /// </summary>
+    inline const pair<vector<int>, PickingPlan>& best_position() const { return global_best; }
+
+    inline double best_fitness() const { return global_best_fitness; }
+
+    /// <summary>
+    /// Non-dominated front of all particles evaluated so far
+    /// </summary>
+    inline const ParetoArchive& pareto_front() const { return archive; }
+
+    /// <summary>
+    /// Allocates the nodes of a front of up to num_points points in advance, so the front does not
+    /// allocate in an iteration until it grows past that
+    /// </summary>
+    inline void reserve_front(size_t num_points) { archive.reserve(num_points); }
+
+    /// <summary>
+    /// Iterations since the global best or the front last improved, over all calls to run
+    /// </summary>
+    inline size_t stale_iterations() const { return stale; }
+
+    /// <summary>
+    /// Iterations completed over all calls to run, restored with the rest of the swarm by a checkpoint
+    /// </summary>
+    inline size_t completed_iterations() const { return iterations_done; }
+
+    /// <summary>
+    /// Writes a checkpoint of the whole swarm every 'interval' iterations, in the background. A run
+    /// restored from it with Checkpoint::load continues exactly where this one was.
+    /// </summary>
+    /// <param name="path"></param>
+    /// <param name="interval"></param>
+    void enable_checkpoints(const string& path, size_t interval);
+
+    /// <summary>
+    /// Replaces the particle with the worst personal best by a migrant tour and picking plan
+    /// </summary>
+    /// <param name="tour"></param>
+    /// <param name="plan"></param>
+    void inject(const vector<int>& tour, const PickingPlan& plan);
+
+private:
+
+    // Saves and restores the state of the swarm
+    friend class Checkpoint;
+
+    /// <summary>
+    /// Builds the initial tours and picking plans of all particles, on the first call to run unless the
+    /// swarm was restored from a checkpoint
+    /// </summary>
+    void initialise_particles();
+
+    /// <summary>
+    /// Throws invalid_argument if a run would never end, without an iteration count, a deadline or a
+    /// stagnation limit
+    /// </summary>
+    void check_stop_condition(const char* caller, size_t iterations, size_t stagnation) const;
+
+    /// <summary>
+    /// Evaluate the particle fitness
+    /// </summary>
+    void evaluate_particle_fitness();
 
     /// <summary>
     /// Update the particle position
@@ -172,23 +333,47 @@ private:
     /// <param name="c2"></param>
     void update_particle_position(double w, double c1, double c2);
 
-    // Vector for travel times
-    vector<double> travel_time_list;
+    // Non-dominated travel times and profits of every evaluated particle
+    ParetoArchive archive;
 
-    // Vector for profits
-    vector<double> profit_list;
+    // Set when an evaluation improves the global best or the front
+    bool improved;
 
-    // Mutex
-    mutex mtx;
-    
-    // Distance matrix
-    const vector<vector<double>>& distances;
+    // Iterations since the last improvement
+    size_t stale;
 
-    // Items
-    const vector<tuple<int, int, int, int>>& items;
+    // Set once the particles hold their initial or restored positions
+    bool initialised;
+
+    // Iterations completed over all calls to run
+    size_t iterations_done;
+
+    // Background writer of the checkpoints and iterations between two checkpoints, 0 if disabled
+    unique_ptr<CheckpointWriter> checkpoint_writer;
+    size_t checkpoint_interval;
+
+    // Thread pool the particles are updated and evaluated on
+    ThreadPool& pool;
+
+    // Deadline of the run, shared by the particles
+    Deadline deadline;
+
+    // Preprocessing of the instance, shared by all particles
+    const InstanceContext& context;
+
+    // Distance oracle
+    const DistanceOracle& distances;
+
+    // Item store
+    const ItemStore& items;
+
+    // Scores the whole swarm in one batch, with the candidates and their values of the last evaluation
+    BatchEvaluator evaluator;
+    vector<BatchCandidate> batch;
+    vector<FitnessValues> batch_values;
 
     // Global best tour and picking plan
-    pair<vector<int>, vector<double>> global_best;
+    pair<vector<int>, PickingPlan> global_best;
     double global_best_fitness;
     double global_best_profit;
     double global_best_time;
@@ -206,8 +391,8 @@ private:
     // Current tour
     vector<int> tour;
 
-    // Picking plan for items
-    vector<double> picking_plan;
+    // Picking plan for items, one bit per item
+    PickingPlan picking_plan;
 
     // Velocity, that is tour and picking plan
     vector<double> velocity;
@@ -223,5 +408,11 @@ private:
 
     // Rent rate
     double rent_rate;
+
+    // Local search run on the particle
+    LocalSearchMode local_search;
+
+    // Master random stream of the swarm, every particle gets its own stream split from it
+    Xoshiro256 rng;
 };
 
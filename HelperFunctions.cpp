@@ -1,165 +1,360 @@
 #include "HelperFunctions.h"
 
-// Function to create distance matrix
-vector<vector<double>> create_distance_matrix(const vector<pair<int, int>>& coordinates)
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "DistanceMetric.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include "Random.h"
+
+double RandomFloat(double a, double b)
 {
-    size_t num_cities = coordinates.size();
-    vector<vector<double>> distances(num_cities, vector<double>(num_cities, 0.0));
+    double random = thread_rng().uniform();
+    double diff = b - a;
+    double r = random * diff;
+    return a + r;
+}
+
 
-    for (size_t i = 0; i < num_cities; ++i)
+namespace {
+    // Skips spaces, tabs and carriage returns
+    inline const char* skip_blanks(const char* p, const char* end)
     {
-        for (size_t j = i + 1; j < num_cities; ++j)
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
         {
-            double x1 = coordinates[i].first;
-            double y1 = coordinates[i].second;
-            double x2 = coordinates[j].first;
-            double y2 = coordinates[j].second;
-            double distance = sqrt(pow(x1 - x2, 2) + pow(y1 - y2, 2));
-            distances[i][j] = distance;
-            distances[j][i] = distance; // Matrix is symmetric
+            ++p;
         }
+        return p;
     }
 
-    return distances;
-}
+    // Parses the next integer of the line, a fractional part is ignored
+    inline const char* parse_int(const char* p, const char* end, int& value)
+    {
+        p = skip_blanks(p, end);
+        auto result = from_chars(p, end, value);
+        p = result.ptr;
+
+        if (p < end && *p == '.')
+        {
+            ++p;
+            while (p < end && *p >= '0' && *p <= '9')
+            {
+                ++p;
+            }
+        }
+        return p;
+    }
 
+    // Parses the next number of the line, with its fractional part
+    inline const char* parse_double(const char* p, const char* end, double& value)
+    {
+        p = skip_blanks(p, end);
+        return from_chars(p, end, value).ptr;
+    }
 
-double RandomFloat(double a, double b)
-{
-    double random = ((double)rand()) / (double)RAND_MAX;
-    double diff = b - a;
-    double r = random * diff;
-    return a + r;
+    // Returns the word after the colon of a header line
+    inline string_view header_name(string_view line)
+    {
+        size_t colon = line.find(':');
+        const char* p = line.data() + (colon == string_view::npos ? 0 : colon + 1);
+        const char* end = line.data() + line.size();
+
+        p = skip_blanks(p, end);
+        const char* last = p;
+        while (last < end && *last != ' ' && *last != '\t' && *last != '\r')
+        {
+            ++last;
+        }
+        return string_view(p, last - p);
+    }
+
+    // Number of values of an EDGE_WEIGHT_SECTION
+    size_t edge_weight_count(EdgeWeightFormat format, size_t n)
+    {
+        switch (format)
+        {
+        case EdgeWeightFormat::UpperRow:
+        case EdgeWeightFormat::LowerRow:
+            return n * (n - 1) / 2;
+        case EdgeWeightFormat::UpperDiagRow:
+        case EdgeWeightFormat::LowerDiagRow:
+            return n * (n + 1) / 2;
+        default:
+            return n * n;
+        }
+    }
+
+    // Parses the first number after the colon of a header line
+    inline double header_value(string_view line)
+    {
+        size_t colon = line.find(':');
+        const char* p = line.data() + (colon == string_view::npos ? 0 : colon + 1);
+        const char* end = line.data() + line.size();
+
+        while (p < end && !(*p >= '0' && *p <= '9'))
+        {
+            ++p;
+        }
+
+        double value = 0;
+        from_chars(p, end, value);
+        return value;
+    }
 }
 
 
 ParsedData parse_bttp_file(const string& file_path)
 {
+    ScopedTimer timer(Phase::Parse);
+
     ParsedData parsed_data;
     parsed_data.metadata = {
         {"DIMENSION", 0},
         {"CAPACITY", 0},
         {"MIN_SPEED", 0.0},
         {"MAX_SPEED", 0.0},
-        {"RENTING_RATIO", 0.0}
+        {"RENTING_RATIO", 0.0},
+        {"EDGE_WEIGHT_TYPE", static_cast<double>(EdgeWeightType::Ceil2D)}
     };
 
     parsed_data.items.emplace_back(0, 0, 0, 0);
 
-    ifstream file(file_path);
+    // Map the whole file, lines are scanned in place without copies
+    MappedFile file(file_path);
     if (!file.is_open())
     {
-        cerr << "Error opening file: " << file_path << endl;
-        exit(1);
+        throw runtime_error("Error opening file: " + file_path);
     }
 
-    string line;
-    bool reading_nodes = false, reading_items = false;
+    const char* p = file.data();
+    const char* end = p + file.size();
+    bool reading_nodes = false, reading_items = false, reading_weights = false;
 
-    while (getline(file, line))
+    while (p < end)
     {
-        line = regex_replace(line, regex("^ +| +$|( ) +"), "$1");
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (line_end == nullptr)
+        {
+            line_end = end;
+        }
 
-        // Parse metadata
-        if (line.find("DIMENSION") != string::npos)
+        const char* start = skip_blanks(p, line_end);
+        p = line_end + 1;
+
+        if (start == line_end)
         {
-            parsed_data.metadata["DIMENSION"] = stoi(line.substr(line.find(":\t") + 1));
+            continue;
         }
-        else if (line.find("CAPACITY") != string::npos)
+
+        // Data lines start with a digit, everything else is a header or section line
+        if (*start >= '0' && *start <= '9')
         {
-            smatch match;
-            if (regex_search(line, match, regex("\\d+")))
+            // Parse nodes (INDEX, X, Y), GEO coordinates have a fractional part
+            if (reading_nodes)
             {
-                parsed_data.metadata["CAPACITY"] = stoi(match.str());
+                int index = 0;
+                double x = 0, y = 0;
+                const char* q = parse_int(start, line_end, index);
+                q = parse_double(q, line_end, x);
+                parse_double(q, line_end, y);
+                parsed_data.nodes.emplace_back(x, y);
             }
-        }
-        else if (line.find("MIN SPEED") != string::npos)
-        {
-            smatch match;
-            if (regex_search(line, match, regex("\\d+\\.\\d+")))
+            // Parse edge weights, a row may span several lines
+            else if (reading_weights)
             {
-                parsed_data.metadata["MIN_SPEED"] = stod(match.str());
+                const char* q = start;
+                while (q < line_end)
+                {
+                    int weight = 0;
+                    const char* next = parse_int(q, line_end, weight);
+
+                    // A token that is not a number would never be consumed
+                    if (next == skip_blanks(q, line_end))
+                    {
+                        throw runtime_error("Invalid edge weight '" + string(next, line_end - next) + "' in " + file_path);
+                    }
+                    parsed_data.edge_weights.push_back(weight);
+                    q = skip_blanks(next, line_end);
+                }
             }
-        }
-        else if (line.find("MAX SPEED") != string::npos)
-        {
-            smatch match;
-            if (regex_search(line, match, regex("\\d+")))
+            // Parse items (INDEX, PROFIT, WEIGHT, ASSIGNED NODE NUMBER)
+            else if (reading_items)
             {
-                parsed_data.metadata["MAX_SPEED"] = stod(match.str());
+                int index = 0, profit = 0, weight = 0, assigned_node = 0;
+                const char* q = parse_int(start, line_end, index);
+                q = parse_int(q, line_end, profit);
+                q = parse_int(q, line_end, weight);
+                parse_int(q, line_end, assigned_node);
+                parsed_data.items.emplace_back(index, profit, weight, assigned_node - 1);
             }
+            continue;
         }
-        else if (line.find("NUMBER OF ITEMS") != string::npos)
+
+        string_view line(start, line_end - start);
+
+        // Parse metadata
+        if (line.find("DIMENSION") != string_view::npos)
+        {
+            parsed_data.metadata["DIMENSION"] = header_value(line);
+            parsed_data.nodes.reserve(static_cast<size_t>(parsed_data.metadata["DIMENSION"]));
+        }
+        else if (line.find("CAPACITY") != string_view::npos)
+        {
+            parsed_data.metadata["CAPACITY"] = header_value(line);
+        }
+        else if (line.find("MIN SPEED") != string_view::npos)
+        {
+            parsed_data.metadata["MIN_SPEED"] = header_value(line);
+        }
+        else if (line.find("MAX SPEED") != string_view::npos)
         {
-            smatch match;
-            if (regex_search(line, match, regex("\\d+")))
+            parsed_data.metadata["MAX_SPEED"] = header_value(line);
+        }
+        else if (line.find("NUMBER OF ITEMS") != string_view::npos)
+        {
+            parsed_data.metadata["NUMBER_OF_ITEMS"] = header_value(line);
+            parsed_data.items.reserve(static_cast<size_t>(parsed_data.metadata["NUMBER_OF_ITEMS"]) + 1);
+        }
+        else if (line.find("RENTING RATIO") != string_view::npos)
+        {
+            parsed_data.metadata["RENTING_RATIO"] = header_value(line);
+        }
+        else if (line.find("EDGE_WEIGHT_TYPE") != string_view::npos)
+        {
+            EdgeWeightType type;
+            if (!parse_edge_weight_type(header_name(line), type))
             {
-                parsed_data.metadata["NUMBER_OF_ITEMS"] = stod(match.str());
+                throw runtime_error("Unsupported EDGE_WEIGHT_TYPE " + string(header_name(line)) + " in " + file_path);
             }
+            parsed_data.metadata["EDGE_WEIGHT_TYPE"] = static_cast<double>(type);
         }
-        else if (line.find("RENTING RATIO") != string::npos)
+        else if (line.find("EDGE_WEIGHT_FORMAT") != string_view::npos)
         {
-            smatch match;
-            if (regex_search(line, match, regex("\\d+\\.\\d+")))
+            EdgeWeightFormat format;
+            if (!parse_edge_weight_format(header_name(line), format))
             {
-                parsed_data.metadata["RENTING_RATIO"] = stod(match.str());
+                throw runtime_error("Unsupported EDGE_WEIGHT_FORMAT " + string(header_name(line)) + " in " + file_path);
             }
+            parsed_data.metadata["EDGE_WEIGHT_FORMAT"] = static_cast<double>(format);
         }
-        else if (line.find("EDGE_WEIGHT_TYPE") != string::npos)
+        else if (line.find("NODE_COORD_SECTION") != string_view::npos)
         {
-            parsed_data.metadata["EDGE_WEIGHT_TYPE"] = 0; // Placeholder for EDGE_WEIGHT_TYPE
+            reading_nodes = true;
+            reading_items = false;
+            reading_weights = false;
         }
-        else if (line.find("NODE_COORD_SECTION") != string::npos)
+        else if (line.find("EDGE_WEIGHT_SECTION") != string_view::npos)
         {
-            reading_nodes = true;
+            reading_nodes = false;
             reading_items = false;
-            continue;
+            reading_weights = true;
         }
-        else if (line.find("ITEMS SECTION") != string::npos)
+        else if (line.find("ITEMS SECTION") != string_view::npos)
         {
             reading_nodes = false;
             reading_items = true;
-            continue;
+            reading_weights = false;
         }
-        else if (line.find("EOF") != string::npos)
+        else if (line.find("EOF") != string_view::npos)
         {
             break;
         }
+        else
+        {
+            // Any other section, such as DISPLAY_DATA_SECTION, is skipped
+            reading_nodes = reading_items = reading_weights = false;
+        }
+    }
 
-        // Parse nodes (INDEX, X, Y)
-        if (reading_nodes)
+    // An EXPLICIT instance is only usable with its whole matrix
+    if (static_cast<EdgeWeightType>(static_cast<int>(parsed_data.metadata["EDGE_WEIGHT_TYPE"])) == EdgeWeightType::Explicit)
+    {
+        auto format = static_cast<EdgeWeightFormat>(static_cast<int>(parsed_data.metadata["EDGE_WEIGHT_FORMAT"]));
+        size_t expected = edge_weight_count(format, static_cast<size_t>(parsed_data.metadata["DIMENSION"]));
+        if (parsed_data.edge_weights.size() != expected)
         {
-            istringstream iss(line);
-            int index, x, y;
+            throw runtime_error("Expected " + to_string(expected) + " edge weights in " + file_path + ", found "
+                + to_string(parsed_data.edge_weights.size()));
+        }
+    }
+
+    return parsed_data;
+}
 
-            smatch match;
-            if (regex_match(line, match, regex("^(\\d+)\\s+(\\d+)\\s+(\\d+)$")))
-            {
-                index = stoi(match[1].str());
-                x = stoi(match[2].str());
-                y = stoi(match[3].str());
-            }
 
-            iss >> index >> x >> y;
-            parsed_data.nodes.emplace_back(x, y);
+string temporary_path(const string& path)
+{
+#ifdef _WIN32
+    unsigned long pid = static_cast<unsigned long>(_getpid());
+#else
+    unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+    // The process id tells apart the writers of different processes, the counter those of the threads of one
+    static atomic<uint64_t> counter(0);
+    return path + "." + to_string(pid) + "-" + to_string(counter++) + ".tmp";
+}
+
+
+bool write_file_atomic(const string& path, string_view contents)
+{
+    string temp_path = temporary_path(path);
+    {
+        // The last bytes are only written out by the close, so its error counts too
+        ofstream file(temp_path, ios::binary | ios::trunc);
+        if (file.is_open())
+        {
+            file.write(contents.data(), static_cast<streamsize>(contents.size()));
+            file.close();
         }
-        else if (reading_items)
+        if (!file)
         {
-            int index, profit, weight, assigned_node;
+            remove(temp_path.c_str());
+            return false;
+        }
+    }
 
-            smatch match;
-            if (regex_match(line, match, regex("^(\\d+)\\s+(\\d+)\\s+(\\d+)\\s+(\\d+)$")))
-            {
-                index = stoi(match[1].str());
-                profit = stoi(match[2].str());
-                weight = stoi(match[3].str());
-                assigned_node = stoi(match[4].str()) - 1;
-            }
+    if (rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
 
-            parsed_data.items.emplace_back(index, profit, weight, assigned_node);
+
+string json_escape(string_view text)
+{
+    string escaped;
+    escaped.reserve(text.size());
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            // Control characters may not appear in a JSON string
+            char code[7];
+            snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+            escaped += code;
+        }
+        else
+        {
+            escaped += c;
         }
     }
-
-    file.close();
-    return parsed_data;
-}
\ No newline at end of file
+    return escaped;
+}
@@ -1,21 +1,35 @@
 #pragma once
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <map>
-#include <sstream>
-#include <regex>
+#include <string>
+#include <string_view>
+#include <tuple>
 #include <vector>
 
 using namespace std;
 
 struct ParsedData {
     map<string, double> metadata;
-    vector<pair<int, int>> nodes;
+    vector<pair<double, double>> nodes;
+
+    // Values of the EDGE_WEIGHT_SECTION of an EXPLICIT instance, in the order of its EDGE_WEIGHT_FORMAT
+    vector<int32_t> edge_weights;
     vector<tuple<int, int, int, int>> items;
 };
 
-vector<vector<double>> create_distance_matrix(const vector<pair<int, int>>& coordinates);
-
 double RandomFloat(double a, double b);
 
-ParsedData parse_bttp_file(const string& file_path);
\ No newline at end of file
+// Parses an instance file, throws runtime_error if it cannot be read or is malformed
+ParsedData parse_bttp_file(const string& file_path);
+
+// Name of a temporary file next to path, unique within the host, so concurrent writers of the same file
+// never write into each other's temporary file
+string temporary_path(const string& path);
+
+// Writes a file through a temporary file renamed into place, so readers never see a half written file
+bool write_file_atomic(const string& path, string_view contents);
+
+// Text as the contents of a JSON string, with quotes, backslashes and control characters escaped
+string json_escape(string_view text);
@@ -0,0 +1,350 @@
+#include "InstanceCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include "DistanceOracle.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+namespace {
+
+    // Fixed-size header at the start of the cache file
+    struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint64_t num_metadata;
+        uint64_t num_nodes;
+        uint64_t num_items;
+        uint64_t num_cities;
+        uint64_t num_candidates;
+        uint64_t num_edge_weights;
+
+        // Checksum of all the sections after the header
+        uint64_t checksum;
+    };
+
+    // Metadata entry, the key is zero padded
+    struct MetadataEntry {
+        char key[32];
+        double value;
+    };
+
+    static_assert(sizeof(CacheHeader) % 8 == 0, "the first section follows the header without padding");
+
+    const char cache_magic[8] = { 'P', 'S', 'O', 'T', 'T', 'P', 'C', '\0' };
+
+    // Sections start on 8-byte boundaries
+    size_t aligned(size_t bytes)
+    {
+        return (bytes + 7) & ~static_cast<size_t>(7);
+    }
+
+    // Checksum of the sections, fed 8 bytes at a time. A cache torn by a crash or by another writer does
+    // not match it.
+    class Checksum {
+    public:
+        void add(const char* data, size_t bytes)
+        {
+            while (bytes > 0 && filled > 0)
+            {
+                push(*data++);
+                bytes--;
+            }
+            for (; bytes >= 8; data += 8, bytes -= 8)
+            {
+                uint64_t word;
+                memcpy(&word, data, 8);
+                mix(word);
+            }
+            while (bytes-- > 0)
+            {
+                push(*data++);
+            }
+        }
+
+        inline uint64_t value() const { return hash; }
+
+    private:
+        void push(char byte)
+        {
+            pending[filled++] = byte;
+            if (filled == 8)
+            {
+                uint64_t word;
+                memcpy(&word, pending, 8);
+                mix(word);
+                filled = 0;
+            }
+        }
+
+        inline void mix(uint64_t word)
+        {
+            hash = (hash ^ word) * 0x100000001b3ull;
+            hash ^= hash >> 32;
+        }
+
+        uint64_t hash = 0xcbf29ce484222325ull;
+        char pending[8] = {};
+        size_t filled = 0;
+    };
+
+    // Size and modification time of the instance file, used to detect a stale cache
+    bool source_stamp(const string& file_path, uint64_t& size, int64_t& mtime)
+    {
+        error_code ec;
+        size = filesystem::file_size(file_path, ec);
+        if (ec)
+        {
+            return false;
+        }
+        auto time = filesystem::last_write_time(file_path, ec);
+        if (ec)
+        {
+            return false;
+        }
+        mtime = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    // Copies the next section of the mapped file into a vector, fails if the file is too short
+    template <class T>
+    bool read_section(const MappedFile& file, size_t& offset, size_t count, vector<T>& out)
+    {
+        size_t bytes = count * sizeof(T);
+        if (offset + bytes > file.size())
+        {
+            return false;
+        }
+        out.resize(count);
+        if (bytes > 0)
+        {
+            memcpy(static_cast<void*>(out.data()), file.data() + offset, bytes);
+        }
+        offset += aligned(bytes);
+        return true;
+    }
+
+    template <class T>
+    void write_section(ofstream& file, const T* data, size_t count, Checksum& checksum)
+    {
+        static const char padding[8] = {};
+        size_t bytes = count * sizeof(T);
+        file.write(reinterpret_cast<const char*>(data), bytes);
+        file.write(padding, aligned(bytes) - bytes);
+        checksum.add(reinterpret_cast<const char*>(data), bytes);
+        checksum.add(padding, aligned(bytes) - bytes);
+    }
+}
+
+
+string InstanceCache::cache_path(const string& file_path)
+{
+    return file_path + extension;
+}
+
+
+bool InstanceCache::is_cache_file(const string& file_path)
+{
+    string name = filesystem::path(file_path).filename().string();
+    string suffix = extension;
+    return name.find(suffix + ".") != string::npos
+        || (name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+
+bool InstanceCache::load(const string& file_path, size_t num_candidates, Instance& instance)
+{
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!source_stamp(file_path, source_size, source_mtime))
+    {
+        return false;
+    }
+
+    MappedFile file(cache_path(file_path));
+    if (!file.is_open() || file.size() < sizeof(CacheHeader))
+    {
+        return false;
+    }
+
+    CacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != version
+        || header.header_size != sizeof(CacheHeader) || header.source_size != source_size
+        || header.source_mtime != source_mtime || header.num_items == 0 || header.num_cities == 0)
+    {
+        return false;
+    }
+
+    // The candidate lists hold at most every other city, so the cache stores the clamped number
+    if (header.num_candidates != min<uint64_t>(num_candidates, header.num_cities - 1))
+    {
+        return false;
+    }
+
+    size_t offset = aligned(sizeof(CacheHeader));
+
+    vector<MetadataEntry> metadata;
+    vector<pair<double, double>> nodes;
+    vector<int32_t> edge_weights;
+    auto items = unique_ptr<ItemStore>(new ItemStore());
+    auto candidates = unique_ptr<CandidateLists>(new CandidateLists());
+
+    bool ok = read_section(file, offset, header.num_metadata, metadata)
+        && read_section(file, offset, header.num_nodes, nodes)
+        && read_section(file, offset, header.num_edge_weights, edge_weights)
+        && read_section(file, offset, header.num_items, items->profits)
+        && read_section(file, offset, header.num_items, items->weights)
+        && read_section(file, offset, header.num_items, items->nodes)
+        && read_section(file, offset, header.num_cities + 1, items->city_offsets)
+        && read_section(file, offset, header.num_items - 1, items->city_items)
+        && read_section(file, offset, header.num_cities * header.num_candidates, candidates->neighbors);
+    if (!ok)
+    {
+        return false;
+    }
+
+    Checksum checksum;
+    size_t first = aligned(sizeof(CacheHeader));
+    checksum.add(file.data() + first, offset - first);
+    if (checksum.value() != header.checksum)
+    {
+        return false;
+    }
+
+    ParsedData parsed_data;
+    for (const auto& entry : metadata)
+    {
+        parsed_data.metadata[string(entry.key, strnlen(entry.key, sizeof(entry.key)))] = entry.value;
+    }
+    parsed_data.nodes = move(nodes);
+    parsed_data.edge_weights = move(edge_weights);
+    candidates->k = header.num_candidates;
+
+    instance.parsed_data = move(parsed_data);
+    instance.items = move(items);
+    instance.candidates = move(candidates);
+    return true;
+}
+
+
+bool InstanceCache::save(const string& file_path, const Instance& instance)
+{
+    CacheHeader header = {};
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = version;
+    header.header_size = sizeof(CacheHeader);
+    if (!source_stamp(file_path, header.source_size, header.source_mtime))
+    {
+        return false;
+    }
+
+    const ItemStore& items = *instance.items;
+    const CandidateLists& candidates = *instance.candidates;
+
+    vector<MetadataEntry> metadata;
+    for (const auto& m : instance.parsed_data.metadata)
+    {
+        MetadataEntry entry = {};
+        if (m.first.size() >= sizeof(entry.key))
+        {
+            return false;
+        }
+        memcpy(entry.key, m.first.data(), m.first.size());
+        entry.value = m.second;
+        metadata.push_back(entry);
+    }
+
+    header.num_metadata = metadata.size();
+    header.num_nodes = instance.parsed_data.nodes.size();
+    header.num_items = items.size();
+    header.num_cities = items.num_cities();
+    header.num_candidates = candidates.size();
+    header.num_edge_weights = instance.parsed_data.edge_weights.size();
+
+    // Write to a temporary file of this writer first, so a concurrent or interrupted run never sees half a
+    // cache. The header is written again at the end with the checksum of the sections.
+    string path = cache_path(file_path);
+    string temp_path = temporary_path(path);
+    {
+        ofstream file(temp_path, ios::binary | ios::trunc);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        Checksum checksum;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_section(file, metadata.data(), metadata.size(), checksum);
+        write_section(file, instance.parsed_data.nodes.data(), instance.parsed_data.nodes.size(), checksum);
+        write_section(file, instance.parsed_data.edge_weights.data(), instance.parsed_data.edge_weights.size(), checksum);
+        write_section(file, items.profits.data(), items.profits.size(), checksum);
+        write_section(file, items.weights.data(), items.weights.size(), checksum);
+        write_section(file, items.nodes.data(), items.nodes.size(), checksum);
+        write_section(file, items.city_offsets.data(), items.city_offsets.size(), checksum);
+        write_section(file, items.city_items.data(), items.city_items.size(), checksum);
+        write_section(file, candidates.neighbors.data(), candidates.neighbors.size(), checksum);
+
+        header.checksum = checksum.value();
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        if (!file.good())
+        {
+            file.close();
+            filesystem::remove(temp_path);
+            return false;
+        }
+    }
+
+    error_code ec;
+    filesystem::rename(temp_path, path, ec);
+    if (ec)
+    {
+        filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+
+Instance load_instance(const string& file_path, size_t num_candidates)
+{
+    ScopedTimer timer(Phase::Load);
+
+    Instance instance;
+    if (InstanceCache::load(file_path, num_candidates, instance))
+    {
+        return instance;
+    }
+
+    // Parse the data from test file, and get all the relevant information
+    instance.parsed_data = parse_bttp_file(file_path);
+    size_t num_cities = static_cast<size_t>(instance.parsed_data.metadata["DIMENSION"]);
+
+    // Build the item store, with the items of every city sorted by profit/weight
+    instance.items = make_unique<ItemStore>(instance.parsed_data.items, num_cities);
+
+    // Build the nearest neighbour candidate lists used by the tour moves, the grid only works on planar metrics
+    auto metric = static_cast<EdgeWeightType>(static_cast<int>(instance.parsed_data.metadata["EDGE_WEIGHT_TYPE"]));
+    if (metric == EdgeWeightType::Ceil2D || metric == EdgeWeightType::Euc2D)
+    {
+        instance.candidates = make_unique<CandidateLists>(instance.parsed_data.nodes, num_candidates);
+    }
+    else
+    {
+        instance.candidates = make_unique<CandidateLists>(DistanceOracle(instance.parsed_data), num_candidates);
+    }
+
+    // A missing cache only costs the preprocessing on the next run
+    if (!InstanceCache::save(file_path, instance))
+    {
+        cerr << "Could not write the instance cache for " << file_path << endl;
+    }
+
+    return instance;
+}
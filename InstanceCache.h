@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "CandidateLists.h"
+#include "HelperFunctions.h"
+#include "ItemStore.h"
+
+using namespace std;
+
+/// <summary>
+/// Instance with its preprocessed structures, loaded from the text file or from its binary cache.
+/// When it comes from the cache, parsed_data.items is left empty, the item store holds the items.
+/// </summary>
+struct Instance {
+    ParsedData parsed_data;
+    unique_ptr<ItemStore> items;
+    unique_ptr<CandidateLists> candidates;
+};
+
+/// <summary>
+/// Versioned binary cache of a preprocessed instance, written next to the instance file with the
+/// extension ".ttpcache". It holds the metadata, the node coordinates, the explicit edge weights, the
+/// SoA item arrays, the per-city sorted item order and the candidate lists. Every section is 8-byte aligned
+/// so the file can be memory-mapped and copied section by section. The header holds a checksum of the
+/// sections, so a torn file is rejected. The cache is ignored and rewritten when the version, the size or
+/// modification time of the instance file, the number of candidates or the checksum differ. The number of
+/// candidates is compared after clamping it to the number of cities minus one.
+/// </summary>
+class InstanceCache {
+public:
+    // Current format version, bump it whenever the layout changes
+    static constexpr uint32_t version = 3;
+
+    // Extension of the cache files
+    static constexpr const char* extension = ".ttpcache";
+
+    /// <summary>
+    /// Path of the cache file of an instance
+    /// </summary>
+    static string cache_path(const string& file_path);
+
+    /// <summary>
+    /// True for a cache file, or a temporary file a writer of a cache left behind
+    /// </summary>
+    static bool is_cache_file(const string& file_path);
+
+    /// <summary>
+    /// Reads the cache of an instance, returns false if it is missing, stale or damaged
+    /// </summary>
+    static bool load(const string& file_path, size_t num_candidates, Instance& instance);
+
+    /// <summary>
+    /// Writes the cache of an instance, through a temporary file of its own renamed into place
+    /// </summary>
+    static bool save(const string& file_path, const Instance& instance);
+};
+
+/// <summary>
+/// Loads an instance from its cache if it is up to date, otherwise parses the instance file,
+/// builds the item store and candidate lists and writes the cache for the next run
+/// </summary>
+Instance load_instance(const string& file_path, size_t num_candidates = CandidateLists::default_k);
@@ -0,0 +1,34 @@
+#include "InstanceContext.h"
+
+#include <algorithm>
+#include <numeric>
+#include "Profiler.h"
+
+InstanceContext::InstanceContext(const DistanceOracle& distances, const CandidateLists& candidates, const ItemStore& items)
+    :distance_oracle(distances), candidate_lists(candidates), item_store(items)
+{
+    ScopedTimer timer(Phase::Preprocess);
+
+    vector<double> ratios(items.size(), 0.0);
+    for (size_t i = 1; i < items.size(); ++i)
+    {
+        ratios[i] = static_cast<double>(items.profit(i)) / static_cast<double>(items.weight(i));
+    }
+
+    // Sort the item indices by profit/weight once for all particles, the first item is a placeholder
+    order.resize(items.size() > 0 ? items.size() - 1 : 0);
+    iota(order.begin(), order.end(), 1);
+    sort(order.begin(), order.end(), [&ratios](int a, int b) { return ratios[a] > ratios[b]; });
+}
+
+
+double InstanceContext::reference_time(double v_min) const
+{
+    size_t n = distance_oracle.size();
+    double length = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        length += distance_oracle(i, (i + 1) % n);
+    }
+    return length / v_min;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+
+#include "CandidateLists.h"
+#include "DistanceOracle.h"
+#include "ItemStore.h"
+
+using namespace std;
+
+/// <summary>
+/// Immutable preprocessing of an instance, computed once and shared by every particle of every swarm
+/// on the instance. It references the distance oracle, candidate lists and item store, whose per-city
+/// item ranges are already in priority order, and holds the global packing order of the items. Particles keep only their tour, plan and velocity.
+/// </summary>
+class InstanceContext {
+public:
+    InstanceContext(const DistanceOracle& distances, const CandidateLists& candidates, const ItemStore& items);
+
+    InstanceContext(const InstanceContext&) = delete;
+    InstanceContext& operator=(const InstanceContext&) = delete;
+
+    inline const DistanceOracle& distances() const { return distance_oracle; }
+
+    inline const CandidateLists& candidates() const { return candidate_lists; }
+
+    inline const ItemStore& items() const { return item_store; }
+
+    /// <summary>
+    /// All items sorted by profit/weight with the highest first, the placeholder item 0 excluded
+    /// </summary>
+    inline const vector<int>& packing_order() const { return order; }
+
+    /// <summary>
+    /// Travel time of the reference point of the hypervolume: the tour that visits the cities in instance
+    /// order, with an empty plan, times the largest slowdown a knapsack can cause, v_max / v_min. It is
+    /// the time of that tour at the minimum speed. It only depends on the instance, so the hypervolumes
+    /// of all runs on an instance can be compared.
+    /// </summary>
+    double reference_time(double v_min) const;
+
+private:
+
+    const DistanceOracle& distance_oracle;
+    const CandidateLists& candidate_lists;
+    const ItemStore& item_store;
+
+    vector<int> order;
+};
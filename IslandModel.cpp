@@ -0,0 +1,263 @@
+#include "IslandModel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    // Header of a migrant message, followed by the tour and the picking plan words
+    struct MigrantHeader {
+        double fitness;
+        uint64_t num_cities;
+        uint64_t num_words;
+    };
+}
+
+
+IslandModel::IslandModel(const IslandOptions& options, size_t num_particles, const InstanceContext& context,
+    size_t num_cities, size_t num_items, double capacity, double v_max, double v_min, double rent_rate,
+    LocalSearchMode local_search, uint64_t seed, const Deadline& deadline)
+    :options(options), num_cities(num_cities), num_items(num_items), threads_per_island(1), deadline(deadline),
+    sent(0), received(0)
+{
+    size_t num_islands = max<size_t>(1, options.num_islands);
+    size_t num_processes = max<size_t>(1, this->options.num_processes);
+    this->options.migration_interval = max<size_t>(1, options.migration_interval);
+    this->options.mailbox_capacity = max<size_t>(1, options.mailbox_capacity);
+
+    // Share the hardware threads of the host between all the islands of all the processes
+    size_t hardware_threads = max(1u, thread::hardware_concurrency());
+    size_t threads = options.threads_per_island > 0 ? options.threads_per_island
+        : max<size_t>(1, hardware_threads / (num_islands * num_processes));
+    threads_per_island = threads;
+
+    // Every thread of the islands reports to the profiler of the thread that builds the model
+    Profiler* profiler = &Profiler::instance();
+    this->profiler = profiler;
+
+    islands.resize(num_islands);
+    for (size_t i = 0; i < num_islands; ++i)
+    {
+        Island& island = islands[i];
+        if (options.pin_threads)
+        {
+            size_t first = ((options.process_rank * num_islands + i) * threads) % hardware_threads;
+            for (size_t c = 0; c < threads; ++c)
+            {
+                island.cpus.push_back(static_cast<int>((first + c) % hardware_threads));
+            }
+        }
+
+        // The driver thread of the island works on the pool too and counts as one of its threads, an island
+        // of one thread gets a pool without workers
+        island.pool = make_unique<ThreadPool>(threads - 1, island.cpus,
+            [profiler]() { Profiler::bind(profiler); });
+    }
+
+    // Mailbox i carries the migrants into island i from the island before it in the ring. A process creates
+    // its shared inbox, and attaches to the inbox of the next process when that one has created it.
+    size_t slot_bytes = sizeof(MigrantHeader) + num_cities * sizeof(int) + (num_items + 63) / 64 * sizeof(uint64_t);
+    bool ring = num_islands > 1 || num_processes > 1;
+    for (size_t i = 0; ring && i < num_islands; ++i)
+    {
+        if (i == 0 && num_processes > 1)
+        {
+            size_t previous = (options.process_rank + num_processes - 1) % num_processes;
+            mailboxes.push_back(make_unique<Mailbox>(shm_name(previous, options.process_rank), slot_bytes,
+                this->options.mailbox_capacity, true));
+        }
+        else
+        {
+            mailboxes.push_back(make_unique<Mailbox>(slot_bytes, this->options.mailbox_capacity));
+        }
+        islands[i].inbox = mailboxes.back().get();
+    }
+    for (size_t i = 0; ring && i + 1 < num_islands; ++i)
+    {
+        islands[i].outbox = islands[i + 1].inbox;
+    }
+    for (const auto& mailbox : mailboxes)
+    {
+        if (!mailbox->is_open())
+        {
+            cerr << "Could not open an island mailbox, migration through it is disabled" << endl;
+        }
+    }
+    if (ring && num_processes > 1)
+    {
+        size_t next = (options.process_rank + 1) % num_processes;
+        mailboxes.push_back(make_unique<Mailbox>(shm_name(options.process_rank, next), slot_bytes,
+            this->options.mailbox_capacity, false));
+        islands.back().outbox = mailboxes.back().get();
+    }
+    else if (ring)
+    {
+        islands.back().outbox = islands.front().inbox;
+    }
+
+    // Every island gets its own random stream, and the islands of every process their own range of streams
+    Xoshiro256 streams(seed);
+    for (size_t skip = 0; skip < options.process_rank * num_islands; ++skip)
+    {
+        streams.jump();
+    }
+    vector<uint64_t> seeds;
+    for (size_t i = 0; i < num_islands; ++i)
+    {
+        seeds.push_back(streams.split()());
+    }
+
+    // The swarms only store their parameters here, every island initialises its particles on its own pool
+    // when it first runs
+    for (size_t i = 0; i < num_islands; ++i)
+    {
+        islands[i].pso = make_unique<PSO>(num_particles, context, num_cities, num_items,
+            capacity, v_max, v_min, rent_rate, local_search, seeds[i], this->deadline, *islands[i].pool);
+    }
+}
+
+
+IslandModel::~IslandModel()
+{
+    // The receiving process removes its shared mailbox, the sender keeps its mapping until it exits
+    if (options.num_processes > 1)
+    {
+        size_t previous = (options.process_rank + options.num_processes - 1) % options.num_processes;
+        Mailbox::unlink(shm_name(previous, options.process_rank));
+    }
+
+    // The swarms use the pools, they go first
+    for (auto& island : islands)
+    {
+        island.pso.reset();
+    }
+}
+
+
+string IslandModel::shm_name(size_t from, size_t to) const
+{
+    return options.shm_prefix + "-" + to_string(from) + "-" + to_string(to);
+}
+
+
+void IslandModel::encode(const PSO& pso, vector<char>& message) const
+{
+    const auto& best = pso.best_position();
+    MigrantHeader header{ pso.best_fitness(), best.first.size(), best.second.num_words() };
+
+    size_t tour_bytes = best.first.size() * sizeof(int);
+    size_t plan_bytes = best.second.num_words() * sizeof(uint64_t);
+    message.resize(sizeof(header) + tour_bytes + plan_bytes);
+
+    memcpy(message.data(), &header, sizeof(header));
+    memcpy(message.data() + sizeof(header), best.first.data(), tour_bytes);
+    memcpy(message.data() + sizeof(header) + tour_bytes, best.second.data(), plan_bytes);
+}
+
+
+bool IslandModel::decode(const vector<char>& message, vector<int>& tour, PickingPlan& plan) const
+{
+    MigrantHeader header;
+    if (message.size() < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, message.data(), sizeof(header));
+
+    size_t tour_bytes = num_cities * sizeof(int);
+    size_t plan_bytes = plan.num_words() * sizeof(uint64_t);
+    if (header.num_cities != num_cities || header.num_words != plan.num_words()
+        || message.size() != sizeof(header) + tour_bytes + plan_bytes)
+    {
+        return false;
+    }
+
+    tour.resize(num_cities);
+    memcpy(tour.data(), message.data() + sizeof(header), tour_bytes);
+    memcpy(plan.data(), message.data() + sizeof(header) + tour_bytes, plan_bytes);
+
+    // Swarms that have not been evaluated yet send the placeholder tour
+    for (int city : tour)
+    {
+        if (city < 0 || static_cast<size_t>(city) >= num_cities)
+        {
+            return false;
+        }
+    }
+    return header.fitness > -1e9;
+}
+
+
+void IslandModel::run_island(Island& island, size_t iterations, double w, double c1, double c2, size_t stagnation)
+{
+    ProfilerBinding binding(*profiler);
+    if (!island.cpus.empty())
+    {
+        ThreadPool::pin_current_thread(island.cpus);
+    }
+
+    vector<char> message;
+    vector<int> tour;
+    PickingPlan plan(num_items);
+
+    for (size_t done = 0; iterations == 0 || done < iterations;)
+    {
+        size_t step = iterations == 0 ? options.migration_interval : min(options.migration_interval, iterations - done);
+        island.pso->run(step, w, c1, c2, stagnation);
+        done += step;
+
+        // Send the best solution of the island, a full mailbox drops it
+        if (island.outbox != nullptr)
+        {
+            encode(*island.pso, message);
+            if (island.outbox->push(message.data(), message.size()))
+            {
+                sent++;
+            }
+        }
+
+        // Take in the migrants waiting for the island
+        while (island.inbox != nullptr && island.inbox->pop(message))
+        {
+            if (decode(message, tour, plan))
+            {
+                island.pso->inject(tour, plan);
+                received++;
+            }
+        }
+
+        if (deadline.expired() || (stagnation > 0 && island.pso->stale_iterations() >= stagnation))
+        {
+            break;
+        }
+    }
+}
+
+
+const ParetoArchive& IslandModel::run(size_t iterations, double w, double c1, double c2, size_t stagnation)
+{
+    // Without an iteration count, deadline or stagnation limit the run would never end
+    if (iterations == 0 && stagnation == 0 && !deadline.is_limited())
+    {
+        throw invalid_argument("IslandModel::run needs an iteration count, a deadline or a stagnation limit");
+    }
+
+    vector<thread> drivers;
+    for (auto& island : islands)
+    {
+        drivers.emplace_back([&, this]() { run_island(island, iterations, w, c1, c2, stagnation); });
+    }
+    for (auto& t : drivers)
+    {
+        t.join();
+    }
+
+    // Merge the fronts of all islands
+    archive.clear();
+    for (const auto& island : islands)
+    {
+        archive.merge(island.pso->pareto_front());
+    }
+    return archive;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HelperClasses.h"
+#include "Mailbox.h"
+
+using namespace std;
+
+/// <summary>
+/// Settings of the island model
+/// </summary>
+struct IslandOptions {
+    // Swarms run by this process
+    size_t num_islands = 1;
+
+    // Threads of every island, its driver thread included. 0 shares the hardware threads between the islands.
+    size_t threads_per_island = 0;
+
+    // Pins every island to its own CPUs
+    bool pin_threads = true;
+
+    // Iterations between two migrations. The solver lowers it to one less than the iteration count of a
+    // shorter run.
+    size_t migration_interval = 5;
+
+    // Messages a mailbox holds before new migrants are dropped
+    size_t mailbox_capacity = 4;
+
+    // Processes taking part in the run on this host, and the rank of this one. With more than one process
+    // the last island of every process sends its migrants to the first island of the next process over
+    // POSIX shared memory.
+    size_t num_processes = 1;
+    size_t process_rank = 0;
+
+    // Prefix of the shared memory objects, the processes of one run must use the same prefix
+    string shm_prefix = "/pso";
+};
+
+/// <summary>
+/// Island model: several independent PSO swarms, each with its own thread pool pinned to its own CPUs.
+/// The islands form a ring. Every few iterations an island sends its best tour and picking plan to the
+/// next island through a lock-free mailbox and takes in the migrants waiting in its own mailbox, which
+/// replace its worst particles. The islands never wait for each other. Between processes the ring is
+/// closed through mailboxes in shared memory.
+/// </summary>
+class IslandModel {
+public:
+    IslandModel(const IslandOptions& options, size_t num_particles, const InstanceContext& context,
+        size_t num_cities, size_t num_items, double capacity, double v_max, double v_min, double rent_rate,
+        LocalSearchMode local_search, uint64_t seed, const Deadline& deadline = Deadline());
+
+    ~IslandModel();
+
+    /// <summary>
+    /// Runs all islands concurrently, each for the given number of iterations (0 runs until the deadline
+    /// or stagnation), and returns the merged front of all islands. Throws invalid_argument if nothing can
+    /// stop the run.
+    /// </summary>
+    /// <param name="iterations"></param>
+    /// <param name="w"></param>
+    /// <param name="c1"></param>
+    /// <param name="c2"></param>
+    /// <param name="stagnation"></param>
+    /// <returns></returns>
+    const ParetoArchive& run(size_t iterations, double w, double c1, double c2, size_t stagnation = 0);
+
+    inline size_t size() const { return islands.size(); }
+
+    /// <summary>
+    /// Threads of all the islands, their driver threads included
+    /// </summary>
+    inline size_t num_threads() const { return islands.size() * threads_per_island; }
+
+    /// <summary>
+    /// Number of migrants sent and received by the islands of this process
+    /// </summary>
+    inline size_t migrants_sent() const { return sent; }
+
+    inline size_t migrants_received() const { return received; }
+
+private:
+
+    struct Island {
+        vector<int> cpus;
+        unique_ptr<ThreadPool> pool;
+        unique_ptr<PSO> pso;
+        Mailbox* inbox = nullptr;
+        Mailbox* outbox = nullptr;
+    };
+
+    /// <summary>
+    /// Runs one island until its iterations, the deadline or stagnation, migrating every few iterations
+    /// </summary>
+    void run_island(Island& island, size_t iterations, double w, double c1, double c2, size_t stagnation);
+
+    // Serialised migrant: fitness, tour and picking plan words
+    void encode(const PSO& pso, vector<char>& message) const;
+
+    bool decode(const vector<char>& message, vector<int>& tour, PickingPlan& plan) const;
+
+    // Shared memory object carrying the migrants from one process to the next
+    string shm_name(size_t from, size_t to) const;
+
+    IslandOptions options;
+    size_t num_cities;
+    size_t num_items;
+    size_t threads_per_island;
+    Deadline deadline;
+
+    // Profiler of the thread that built the model
+    Profiler* profiler;
+
+    vector<Island> islands;
+    vector<unique_ptr<Mailbox>> mailboxes;
+
+    // Merged front of all islands
+    ParetoArchive archive;
+
+    atomic<size_t> sent;
+    atomic<size_t> received;
+};
@@ -0,0 +1,48 @@
+#include "ItemStore.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+ItemStore::ItemStore(const vector<tuple<int, int, int, int>>& items, size_t num_cities)
+{
+    ScopedTimer timer(Phase::Preprocess);
+
+    profits.reserve(items.size());
+    weights.reserve(items.size());
+    nodes.reserve(items.size());
+
+    for (const auto& i : items)
+    {
+        profits.push_back(get<1>(i));
+        weights.push_back(get<2>(i));
+        nodes.push_back(get<3>(i));
+    }
+
+    // Count the items of every city, the first item is a placeholder and belongs to no city
+    city_offsets.assign(num_cities + 1, 0);
+    for (size_t i = 1; i < items.size(); ++i)
+    {
+        city_offsets[nodes[i] + 1]++;
+    }
+    for (size_t c = 1; c <= num_cities; ++c)
+    {
+        city_offsets[c] += city_offsets[c - 1];
+    }
+
+    city_items.resize(city_offsets[num_cities]);
+    vector<int> fill(city_offsets.begin(), city_offsets.end() - 1);
+    for (size_t i = 1; i < items.size(); ++i)
+    {
+        city_items[fill[nodes[i]]++] = static_cast<int>(i);
+    }
+
+    // Prioritise the items with higher profit/weight in every city
+    for (size_t c = 0; c < num_cities; ++c)
+    {
+        sort(city_items.begin() + city_offsets[c], city_items.begin() + city_offsets[c + 1],
+            [this](int a, int b) {
+            return (profits[a] / static_cast<double>(weights[a])) > (profits[b] / static_cast<double>(weights[b]));
+            });
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+/// <summary>
+/// Immutable structure-of-arrays item store, built once per instance and shared by all particles.
+/// Profits, weights and assigned cities live in separate arrays indexed by the item index, and a
+/// CSR index maps every city to a contiguous range of its items, sorted by profit/weight.
+/// </summary>
+class ItemStore {
+public:
+    ItemStore(const vector<tuple<int, int, int, int>>& items, size_t num_cities);
+
+    /// <summary>
+    /// Number of items, the placeholder item 0 included
+    /// </summary>
+    inline size_t size() const { return profits.size(); }
+
+    inline size_t num_cities() const { return city_offsets.size() - 1; }
+
+    inline int profit(size_t item) const { return profits[item]; }
+
+    inline int weight(size_t item) const { return weights[item]; }
+
+    inline int node(size_t item) const { return nodes[item]; }
+
+    inline const int* profit_data() const { return profits.data(); }
+
+    inline const int* weight_data() const { return weights.data(); }
+
+    /// <summary>
+    /// Items of a city, sorted by profit/weight with the highest first
+    /// </summary>
+    inline const int* city_begin(size_t city) const { return city_items.data() + city_offsets[city]; }
+
+    inline const int* city_end(size_t city) const { return city_items.data() + city_offsets[city + 1]; }
+
+private:
+
+    // Filled by the instance cache
+    ItemStore() = default;
+    friend class InstanceCache;
+
+    // Profit, weight and assigned city of every item
+    vector<int> profits;
+    vector<int> weights;
+    vector<int> nodes;
+
+    // Items of city c are city_items[city_offsets[c] .. city_offsets[c + 1])
+    vector<int> city_offsets;
+    vector<int> city_items;
+};
@@ -0,0 +1,228 @@
+#include "Mailbox.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const uint32_t mailbox_magic = 0x4d424f58; // "MBOX"
+    const uint32_t mailbox_version = 2;
+
+    size_t round_up(size_t bytes, size_t alignment)
+    {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+}
+
+
+size_t Mailbox::region_size(size_t slot_bytes, size_t capacity)
+{
+    return round_up(sizeof(Header), 64) + capacity * (sizeof(uint64_t) + slot_bytes);
+}
+
+
+Mailbox::Mailbox(size_t slot_bytes, size_t capacity)
+    :header(nullptr), slots(nullptr), slot_bytes(round_up(slot_bytes, 8)), capacity(capacity), region_bytes(0),
+    mapping(nullptr)
+{
+    region_bytes = region_size(this->slot_bytes, capacity);
+    storage.resize((region_bytes + 63) / sizeof(uint64_t) + 8);
+
+    // The header needs its cache line alignment
+    char* base = reinterpret_cast<char*>(storage.data());
+    size_t misalignment = reinterpret_cast<uintptr_t>(base) % 64;
+    header = reinterpret_cast<Header*>(base + (misalignment == 0 ? 0 : 64 - misalignment));
+    format(0);
+}
+
+
+#ifdef _WIN32
+Mailbox::Mailbox(const string& name, size_t slot_bytes, size_t capacity, bool create)
+    :header(nullptr), slots(nullptr), slot_bytes(round_up(slot_bytes, 8)), capacity(capacity), region_bytes(0),
+    mapping(nullptr)
+{
+    // Shared rings are only available with POSIX shared memory
+    (void)name;
+    (void)create;
+}
+
+
+Mailbox::~Mailbox()
+{
+}
+
+
+bool Mailbox::attach()
+{
+    return false;
+}
+
+
+void Mailbox::unlink(const string& name)
+{
+    (void)name;
+}
+#else
+Mailbox::Mailbox(const string& name, size_t slot_bytes, size_t capacity, bool create)
+    :header(nullptr), slots(nullptr), slot_bytes(round_up(slot_bytes, 8)), capacity(capacity), region_bytes(0),
+    mapping(nullptr)
+{
+    region_bytes = region_size(this->slot_bytes, capacity);
+
+    if (create)
+    {
+        // An object of a crashed run keeps its indices and messages, the creator starts from a new one
+        ::shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+        {
+            return;
+        }
+        void* address = ftruncate(fd, static_cast<off_t>(region_bytes)) == 0
+            ? mmap(nullptr, region_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (address == MAP_FAILED)
+        {
+            ::shm_unlink(name.c_str());
+            return;
+        }
+        mapping = address;
+        header = static_cast<Header*>(address);
+        format(static_cast<uint64_t>(getpid()));
+        return;
+    }
+
+    // The sender maps the ring when it has something to send
+    attach_name = name;
+    attach();
+}
+
+
+bool Mailbox::attach()
+{
+    // A stale object is replaced by its creator under the same name, so every attempt opens the name again
+    int fd = shm_open(attach_name.c_str(), O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    void* address = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= region_bytes
+        ? mmap(nullptr, region_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (address == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // The ring must be published by a creator that still runs, with the layout of this side
+    Header* candidate = static_cast<Header*>(address);
+    pid_t owner = static_cast<pid_t>(candidate->owner);
+    if (candidate->magic.load(memory_order_acquire) != mailbox_magic || owner <= 0
+        || (kill(owner, 0) != 0 && errno != EPERM) || candidate->version != mailbox_version
+        || candidate->slot_bytes != slot_bytes || candidate->capacity != capacity)
+    {
+        munmap(address, region_bytes);
+        return false;
+    }
+    mapping = address;
+    header = candidate;
+    slots = reinterpret_cast<char*>(header) + round_up(sizeof(Header), 64);
+    attach_name.clear();
+    return true;
+}
+
+
+Mailbox::~Mailbox()
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, region_bytes);
+    }
+}
+
+
+void Mailbox::unlink(const string& name)
+{
+    ::shm_unlink(name.c_str());
+}
+#endif
+
+
+void Mailbox::format(uint64_t owner)
+{
+    // Shared memory starts zeroed, private memory is constructed in place
+    new (header) Header();
+    header->version = mailbox_version;
+    header->slot_bytes = slot_bytes;
+    header->capacity = capacity;
+    header->owner = owner;
+    header->head.store(0, memory_order_relaxed);
+    header->tail.store(0, memory_order_relaxed);
+    slots = reinterpret_cast<char*>(header) + round_up(sizeof(Header), 64);
+    header->magic.store(mailbox_magic, memory_order_release);
+}
+
+
+bool Mailbox::push(const void* data, size_t bytes)
+{
+    if (header == nullptr && (attach_name.empty() || !attach()))
+    {
+        return false;
+    }
+    if (bytes > slot_bytes)
+    {
+        return false;
+    }
+
+    uint64_t tail = header->tail.load(memory_order_relaxed);
+    uint64_t head = header->head.load(memory_order_acquire);
+    if (tail - head >= capacity)
+    {
+        return false;
+    }
+
+    char* s = slot(tail);
+    uint64_t length = bytes;
+    memcpy(s, &length, sizeof(length));
+    memcpy(s + sizeof(length), data, bytes);
+
+    // Publish the slot to the consumer
+    header->tail.store(tail + 1, memory_order_release);
+    return true;
+}
+
+
+bool Mailbox::pop(vector<char>& message)
+{
+    if (header == nullptr)
+    {
+        return false;
+    }
+
+    uint64_t head = header->head.load(memory_order_relaxed);
+    uint64_t tail = header->tail.load(memory_order_acquire);
+    if (head == tail)
+    {
+        return false;
+    }
+
+    const char* s = slot(head);
+    uint64_t length;
+    memcpy(&length, s, sizeof(length));
+    length = min<uint64_t>(length, slot_bytes);
+    message.assign(s + sizeof(length), s + sizeof(length) + length);
+
+    // Hand the slot back to the producer
+    header->head.store(head + 1, memory_order_release);
+    return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// <summary>
+/// Lock-free single-producer single-consumer ring of fixed-size message slots, laid out in one raw
+/// memory region. The region is either private memory, linking two threads of the process, or a POSIX
+/// shared memory object, linking two processes on the same host. The head and tail indices live in the
+/// region on their own cache lines, a full ring drops new messages instead of blocking the producer.
+/// </summary>
+class Mailbox {
+public:
+    /// <summary>
+    /// Mailbox in private memory, between two threads of the process
+    /// </summary>
+    Mailbox(size_t slot_bytes, size_t capacity);
+
+    /// <summary>
+    /// Mailbox in the named shared memory object. The creating process removes an object left under the
+    /// name by an earlier run and formats a new one. The other process attaches on its first push once a
+    /// ring is formatted by a creator that still runs, so it never uses the indices of a stale ring and
+    /// never waits for a creator that has not started or is already done.
+    /// </summary>
+    Mailbox(const string& name, size_t slot_bytes, size_t capacity, bool create);
+
+    ~Mailbox();
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    inline bool is_open() const { return header != nullptr; }
+
+    /// <summary>
+    /// Largest message in bytes
+    /// </summary>
+    inline size_t slot_size() const { return slot_bytes; }
+
+    /// <summary>
+    /// Copies a message into the ring, returns false if the ring is full, the message too large or the
+    /// shared ring not created yet
+    /// </summary>
+    bool push(const void* data, size_t bytes);
+
+    /// <summary>
+    /// Takes the oldest message out of the ring, returns false if it is empty
+    /// </summary>
+    bool pop(vector<char>& message);
+
+    /// <summary>
+    /// Removes a shared memory object, the processes that mapped it keep their mapping
+    /// </summary>
+    static void unlink(const string& name);
+
+private:
+
+    struct Header {
+        atomic<uint32_t> magic;
+        uint32_t version;
+        uint64_t slot_bytes;
+        uint64_t capacity;
+        // Process that formatted a shared ring, 0 for a private one
+        uint64_t owner;
+        alignas(64) atomic<uint64_t> head;
+        alignas(64) atomic<uint64_t> tail;
+    };
+
+    static size_t region_size(size_t slot_bytes, size_t capacity);
+
+    // Maps the named ring if its creator has formatted it and still runs, returns false otherwise
+    bool attach();
+
+    // Writes an empty ring of the owner process into the region and publishes it with the magic number
+    void format(uint64_t owner);
+
+    // Start of the slot of a ring index, a slot is the message length followed by the message
+    inline char* slot(uint64_t index) const
+    {
+        return slots + (index % capacity) * (sizeof(uint64_t) + slot_bytes);
+    }
+
+    Header* header;
+    char* slots;
+    size_t slot_bytes;
+    size_t capacity;
+    size_t region_bytes;
+
+    // Private memory of the ring, empty for a shared ring
+    vector<uint64_t> storage;
+
+    // Shared memory mapping, null for a private ring
+    void* mapping;
+
+    // Name of a shared ring this process attaches to, empty once attached or if it created the ring
+    string attach_name;
+};
@@ -0,0 +1,85 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const string& path)
+    :opened(false), begin(nullptr), length(0)
+{
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+    {
+        return;
+    }
+
+    ostringstream contents;
+    contents << file.rdbuf();
+    buffer = contents.str();
+
+    opened = true;
+    begin = buffer.data();
+    length = buffer.size();
+}
+
+
+MappedFile::~MappedFile()
+{
+}
+#else
+MappedFile::MappedFile(const string& path)
+    :opened(false), begin(nullptr), length(0), mapping(nullptr)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return;
+    }
+
+    opened = true;
+    length = static_cast<size_t>(info.st_size);
+
+    if (length > 0)
+    {
+        void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            opened = false;
+            length = 0;
+        }
+        else
+        {
+            // The file is read front to back
+            madvise(address, length, MADV_SEQUENTIAL);
+            mapping = address;
+            begin = static_cast<const char*>(address);
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+
+MappedFile::~MappedFile()
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, length);
+    }
+}
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+
+using namespace std;
+
+/// <summary>
+/// Read-only view of a whole file. The file is memory-mapped where the platform supports it,
+/// otherwise it is read into memory once.
+/// </summary>
+class MappedFile {
+public:
+    explicit MappedFile(const string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline bool is_open() const { return opened; }
+
+    inline const char* data() const { return begin; }
+
+    inline size_t size() const { return length; }
+
+private:
+
+    bool opened;
+    const char* begin;
+    size_t length;
+
+#ifdef _WIN32
+    // File contents, the fallback when mapping is not available
+    string buffer;
+#else
+    void* mapping;
+#endif
+};
@@ -1,12 +1,273 @@
 #include <chrono>
 #include <ctime>
 #include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include "BatchRunner.h"
+#include "Checkpoint.h"
 #include "HelperClasses.h"
 #include "HelperFunctions.h"
+#include "InstanceCache.h"
+#include "IslandModel.h"
+#include "ParameterSweep.h"
 
 using namespace std;
 
-int main()
+// Define all the constants
+const size_t num_iterations = 2;
+const size_t num_particles = 20;
+const double w = 0.9; // Inertia weight
+const double c1 = 1.4; // Acceleration coefficient for personal best
+const double c2 = 1.5; // Acceleration coefficient for global best
+const size_t num_candidates = 10; // Nearest neighbour candidates per city
+const size_t stagnation = 200; // Iterations without improvement that end a time-budgeted run
+
+// Reads a count from the environment, the fallback is used when the variable is not set
+size_t env_count(const char* name, size_t fallback)
+{
+    const char* env = getenv(name);
+    return env != nullptr ? static_cast<size_t>(stoull(env)) : fallback;
+}
+
+
+// Cores the runs of this process share, PSO_THREADS or its share of the hardware threads of the host
+size_t core_budget(size_t num_processes)
+{
+    size_t hardware_threads = max(1u, thread::hardware_concurrency());
+    return max<size_t>(1, env_count("PSO_THREADS", hardware_threads / max<size_t>(1, num_processes)));
+}
+
+
+// Local time of a time point, localtime is not thread safe and localtime_s is Windows only
+tm local_time(chrono::system_clock::time_point time)
+{
+    time_t t = chrono::system_clock::to_time_t(time);
+    tm buf{};
+#ifdef _WIN32
+    localtime_s(&buf, &t);
+#else
+    localtime_r(&t, &buf);
+#endif
+    return buf;
+}
+
+
+// Runs the PSO on one instance with the given number of threads, the console output goes to log
+void run_instance(const filesystem::path& path, const string& output_directory, IslandOptions island_options,
+    const string& process_suffix, size_t threads, ostream& log)
+{
+    // Start the timer for checking execution time of algorithm
+    auto start = chrono::system_clock::now();
+
+    // Optional time budget in seconds for the instance, loading included. With a budget the PSO
+    // iterates until the deadline or until it stagnates, instead of a fixed number of iterations.
+    const char* budget_env = getenv("PSO_TIME_BUDGET");
+    const double time_budget = budget_env != nullptr ? stod(budget_env) : 0.0;
+    const Deadline deadline = time_budget > 0 ? Deadline(time_budget) : Deadline();
+
+    // Phase timers and counters of this instance, bound to its threads
+    Profiler profiler;
+    ProfilerBinding binding(profiler);
+
+    // Test file path
+    string file_path = path.string();
+
+    log << "-----------------------------------------------------------------------------------------------" << endl;
+    log << path.filename().string() << endl;
+    log << "-----------------------------------------------------------------------------------------------" << endl;
+
+    // Write the start time to output stream
+    tm start_time = local_time(start);
+    log << "Start time: " << put_time(&start_time, "%Y-%m-%d %X") << endl;
+    log << "Seed: " << master_seed() << endl;
+
+    const uint64_t seed = master_seed(); // Set PSO_SEED to repeat a run
+
+    // Load the instance from its binary cache, or parse the test file and write the cache
+    Instance instance = load_instance(file_path, num_candidates);
+    ParsedData& parsed_data = instance.parsed_data;
+    const ItemStore& items = *instance.items;
+    const CandidateLists& candidates = *instance.candidates;
+
+    // Store the number of cities and items
+    size_t num_cities = (size_t)parsed_data.metadata["DIMENSION"];
+    size_t num_items = (size_t)parsed_data.metadata["NUMBER_OF_ITEMS"]+1;
+
+    // Create the distance oracle with the metric of the instance, computing the distances on demand
+    DistanceOracle distances(parsed_data);
+
+    // Packing order and item ratios, computed once and shared by all particles
+    InstanceContext context(distances, candidates, items);
+
+    // Large instances use the Or-opt/Lin-Kernighan tour engine, repeated 2-OPT passes are too slow there
+    const LocalSearchMode local_search = num_cities > 10000 ? LocalSearchMode::Deep : LocalSearchMode::Restrictive;
+
+    // With a time budget the run goes on until the deadline or stagnation
+    size_t iterations = deadline.is_limited() ? 0 : num_iterations;
+    const size_t stop_after = deadline.is_limited() ? stagnation : 0;
+
+    // Initialise the PSO on its own pool, the calling thread works on the pool too and counts as one of the
+    // threads of the instance. With islands every island gets its own pool instead.
+    const bool island_mode = island_options.num_islands > 1 || island_options.num_processes > 1;
+    unique_ptr<ThreadPool> pool;
+    unique_ptr<PSO> pso;
+    unique_ptr<IslandModel> island_model;
+    if (island_mode)
+    {
+        // The islands exchange migrants at least once before their last iteration, so a run of 2 iterations
+        // migrates after the first one
+        if (iterations > 1)
+        {
+            island_options.migration_interval = min(island_options.migration_interval, iterations - 1);
+        }
+        island_options.shm_prefix = "/pso-" + path.stem().string();
+
+        // Without PSO_ISLAND_THREADS the islands share the threads the batch runner gave the instance
+        if (island_options.threads_per_island == 0)
+        {
+            island_options.threads_per_island = max<size_t>(1, threads / max<size_t>(1, island_options.num_islands));
+        }
+        island_model = make_unique<IslandModel>(island_options, num_particles, context, num_cities, num_items,
+            parsed_data.metadata["CAPACITY"], parsed_data.metadata["MAX_SPEED"], parsed_data.metadata["MIN_SPEED"],
+            parsed_data.metadata["RENTING_RATIO"], local_search, seed, deadline);
+    }
+    else
+    {
+        pool = make_unique<ThreadPool>(threads - 1, vector<int>(),
+            [&profiler]() { Profiler::bind(&profiler); });
+        pso = make_unique<PSO>(num_particles, context, num_cities, num_items,
+            parsed_data.metadata["CAPACITY"], parsed_data.metadata["MAX_SPEED"], parsed_data.metadata["MIN_SPEED"],
+            parsed_data.metadata["RENTING_RATIO"], local_search, seed, deadline, *pool);
+    }
+
+    // The single swarm writes a checkpoint every PSO_CHECKPOINT_INTERVAL iterations, and with PSO_RESUME
+    // continues from the last checkpoint of an interrupted run
+    const string checkpoint_path = output_directory + path.stem().string() + process_suffix + ".checkpoint";
+    const size_t checkpoint_interval = env_count("PSO_CHECKPOINT_INTERVAL", 0);
+    if (pso && env_count("PSO_RESUME", 0) > 0 && Checkpoint::load(checkpoint_path, *pso))
+    {
+        log << "Resumed from " << checkpoint_path << " after " << pso->completed_iterations() << " iterations" << endl;
+        if (iterations > 0)
+        {
+            iterations -= min(iterations - 1, pso->completed_iterations());
+        }
+    }
+    // With PSO_ASYNC the particles of the single swarm loop on their own instead of in lockstep
+    const bool asynchronous = pso && env_count("PSO_ASYNC", 0) > 0;
+    if (pso && !asynchronous)
+    {
+        pso->enable_checkpoints(checkpoint_path, checkpoint_interval);
+    }
+
+    // Run the PSO algorithm, it returns the non-dominated front of travel time and profit
+    const ParetoArchive& front = island_mode ? island_model->run(iterations, w, c1, c2, stop_after)
+        : asynchronous ? pso->run_async(iterations, w, c1, c2, stop_after)
+        : pso->run(iterations, w, c1, c2, stop_after);
+
+    if (island_mode)
+    {
+        log << "Islands: " << island_model->size() << " , " << "Migrants sent: " << island_model->migrants_sent()
+            << " , " << "received: " << island_model->migrants_received() << endl;
+    }
+
+    // Write the front of this run to the output file, ordered by travel time. The point without profit
+    // is left out.
+    ostringstream output;
+    size_t written = 0;
+    for (const auto& point : front)
+    {
+        if (point.second != 0)
+        {
+            // Write the travel time and profit in output file
+            output << point.first << ' ' << point.second << endl;
+            log << "Travel time: " << point.first << " , " << "Profit: " << point.second << endl;
+            written++;
+        }
+    }
+
+    // Against a reference point that only depends on the instance, so runs can be compared
+    double reference_time = context.reference_time(parsed_data.metadata["MIN_SPEED"]);
+    log << "Front size: " << written << " , " << "Hypervolume: " << front.hypervolume(reference_time, 0)
+        << " , " << "Reference time: " << reference_time << endl;
+
+    string output_path = output_directory + path.stem().string() + process_suffix + path.extension().string();
+    if (!write_file_atomic(output_path, output.str()))
+    {
+        cerr << "Could not write the results " << output_path << endl;
+    }
+
+    // End time after completing the execution
+    auto end = chrono::system_clock::now();
+    auto elapsed = end - start;
+    double execution_time = chrono::duration_cast<chrono::duration<double>>(elapsed).count();
+    log << endl << "Execution time: " << execution_time << '\n';
+
+    // Write the run report with the phase timers and counters next to the results
+    string report_path = output_directory + path.stem().string() + process_suffix + ".report.json";
+    if (!profiler.write_json(report_path, path.filename().string(), seed,
+        island_mode ? island_model->num_threads() : threads, execution_time))
+    {
+        cerr << "Could not write the run report " << report_path << endl;
+    }
+
+    // The run is complete, its checkpoint is no longer needed once the writer is done with it
+    if (pso && !asynchronous && checkpoint_interval > 0)
+    {
+        pso.reset();
+        error_code ec;
+        filesystem::remove(checkpoint_path, ec);
+    }
+}
+
+
+// Loads one instance and runs a sweep of PSO configurations on it, then prints and writes the summary
+int run_sweep_mode(const SweepOptions& options, const string& output_directory)
+{
+    filesystem::path path(options.instance);
+    Instance instance;
+    try
+    {
+        instance = load_instance(options.instance, num_candidates);
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    ParsedData& parsed_data = instance.parsed_data;
+
+    size_t num_cities = (size_t)parsed_data.metadata["DIMENSION"];
+    size_t num_items = (size_t)parsed_data.metadata["NUMBER_OF_ITEMS"]+1;
+    DistanceOracle distances(parsed_data);
+    InstanceContext context(distances, *instance.candidates, *instance.items);
+    const LocalSearchMode local_search = num_cities > 10000 ? LocalSearchMode::Deep : LocalSearchMode::Restrictive;
+
+    vector<SweepConfig> configs = sweep_configs(options);
+    cout << path.filename().string() << ": " << configs.size() << " runs, seed " << options.seed << endl;
+
+    // The runs share a pool within the core budget, the calling thread works on it too
+    ThreadPool pool(core_budget(1) - 1);
+
+    auto start = chrono::steady_clock::now();
+    vector<SweepResult> results = run_sweep(configs, context, num_cities, num_items,
+        parsed_data.metadata["CAPACITY"], parsed_data.metadata["MAX_SPEED"], parsed_data.metadata["MIN_SPEED"],
+        parsed_data.metadata["RENTING_RATIO"], local_search, pool);
+    double sweep_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    print_sweep_summary(cout, results);
+    cout << endl << "Sweep time: " << sweep_time << endl;
+
+    string csv_path = options.csv_path.empty() ? output_directory + path.stem().string() + ".sweep.csv" : options.csv_path;
+    if (!write_sweep_csv(csv_path, results))
+    {
+        cerr << "Could not write the sweep results " << csv_path << endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char* argv[])
 {
     // Input directory for the test files
     const string input_directory = "tests/";
@@ -17,74 +278,62 @@ int main()
     // Create output directory if it doesn't exists
     filesystem::create_directory(output_directory);
 
-    // Loop over all the test files
+    // With arguments the PSO sweeps over configurations of one instance instead of running all test files
+    if (argc > 1)
+    {
+        return run_sweep_mode(parse_sweep_options(argc, argv), output_directory);
+    }
+
+    // Island model, a single swarm unless more islands or processes are asked for. Processes of one run
+    // are started with the same PSO_PROCESSES and their own PSO_PROCESS_RANK.
+    IslandOptions island_options;
+    island_options.num_islands = max<size_t>(1, env_count("PSO_ISLANDS", 1));
+    island_options.threads_per_island = env_count("PSO_ISLAND_THREADS", 0);
+    island_options.migration_interval = env_count("PSO_MIGRATION_INTERVAL", island_options.migration_interval);
+    island_options.num_processes = max<size_t>(1, env_count("PSO_PROCESSES", 1));
+    island_options.process_rank = env_count("PSO_PROCESS_RANK", 0) % island_options.num_processes;
+    const bool island_mode = island_options.num_islands > 1 || island_options.num_processes > 1;
+
+    // Every process of a multi-process run writes its own output files
+    const string process_suffix = island_options.num_processes > 1 ? "-p" + to_string(island_options.process_rank) : "";
+
+    // Instances run concurrently within the cores (PSO_THREADS) and the memory in MB (PSO_MEMORY_BUDGET)
+    // of the host, by default the share of the cores of this process and three quarters of the memory
+    const size_t cores = core_budget(island_options.num_processes);
+    const size_t memory = physical_memory();
+    const size_t memory_budget = getenv("PSO_MEMORY_BUDGET") != nullptr ? env_count("PSO_MEMORY_BUDGET", 0) << 20
+        : memory > 0 ? memory / 4 * 3 : SIZE_MAX;
+    BatchRunner batch(memory_budget, cores);
+
+    // Queue all the test files with their estimates from the header
     for (const auto& entry : filesystem::directory_iterator(input_directory))
     {
-        // Start the timer for checking execution time of algorithm
-        auto start = chrono::system_clock::now();
-
-        // Test file path
-        string file_path = entry.path().string();
-
-        cout << "-----------------------------------------------------------------------------------------------" << endl;
-        cout << entry.path().filename().string() << endl;
-        cout << "-----------------------------------------------------------------------------------------------" << endl;
-        
-        // Write the start time to output stream
-        time_t in_time_t = chrono::system_clock::to_time_t(start);
-        struct tm buf;
-        localtime_s(&buf, &in_time_t);
-        cout << "Start time: " << put_time(&buf, "%Y-%m-%d %X") << endl;
-        
-        // Parse the data from test file, and get all the relevant information
-        ParsedData parsed_data = parse_bttp_file(file_path);
-
-        // Store the number of cities and items
-        size_t num_cities = (size_t)parsed_data.metadata["DIMENSION"];
-        size_t num_items = (size_t)parsed_data.metadata["NUMBER_OF_ITEMS"]+1;
-        
-        // Create the distance matrix, containing distance of each node from other
-        vector<vector<double>> distances = create_distance_matrix(parsed_data.nodes);
-
-        // Define all the constants
-        const size_t num_iterations = 2;
-        const size_t num_particles = 20;
-        const double w = 0.9; // Inertia weight
-        const double c1 = 1.4; // Acceleration coefficient for personal best
-        const double c2 = 1.5; // Acceleration coefficient for global best
-
-        // Initialise the PSO
-        PSO pso(num_particles, distances, parsed_data.items, num_cities, num_items, parsed_data.metadata["CAPACITY"],
-            parsed_data.metadata["MAX_SPEED"], parsed_data.metadata["MIN_SPEED"],
-            parsed_data.metadata["RENTING_RATIO"]);
-
-        // Run the PSO algorithm
-        tuple<vector<double>, vector<double>> ret_values = pso.run(num_iterations, w, c1, c2);
-
-        // Store the outputs, travel time and profit list
-        vector<double> travel_time_list = get<0>(ret_values), profit_list = get<1>(ret_values);
-
-        // Open the output file for append
-        ofstream output_file(output_directory + entry.path().filename().string(), ios::app);
-        if (output_file.is_open())
+        // Skip the binary caches written next to the instances
+        if (InstanceCache::is_cache_file(entry.path().string()))
         {
-            // Loop over the output lists
-            for (size_t i = 0; i < profit_list.size(); ++i)
-            {
-                if (profit_list[i] != 0)
-                {
-                    // Write the travel time and profit list in output file
-                    output_file << travel_time_list[i] << ' ' << profit_list[i] << endl;
-                    cout << "Travel time: " << travel_time_list[i] << " , " << "Profit: " << profit_list[i] << endl;
-                }
-            }
+            continue;
         }
 
-        // End time after completing the execution
-        auto end = chrono::system_clock::now();
-        auto elapsed = end - start;
-        cout << endl << "Execution time: " << chrono::duration_cast<chrono::duration<double>>(elapsed).count() << '\n';
+        JobEstimate estimate = estimate_job(entry.path().string(), num_particles, num_candidates);
+
+        // The islands share all the cores, so island runs go one at a time
+        if (island_mode)
+        {
+            estimate.threads = cores;
+        }
+        batch.add(entry.path().string(), estimate);
     }
 
+    // The console output of every instance is printed in one piece when it is done
+    mutex console_mtx;
+    batch.run([&](const BatchJob& job) {
+        ostringstream log;
+        run_instance(job.file_path, output_directory, island_options, process_suffix, job.threads, log);
+        log << "Estimated memory: " << (job.estimate.memory_bytes >> 20) << " MB , " << "Threads: " << job.threads << endl;
+
+        lock_guard<mutex> lock(console_mtx);
+        cout << log.str() << flush;
+    });
+
     return 0;
-}
\ No newline at end of file
+}
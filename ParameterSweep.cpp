@@ -0,0 +1,304 @@
+#include "ParameterSweep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+namespace {
+    const char* usage = "Usage: PSO --sweep instance [--w v,..] [--c1 v,..] [--c2 v,..] [--particles n,..] "
+        "[--iterations n,..] [--seeds N] [--samples N] [--csv file] [--config file]";
+
+    template <class T>
+    vector<T> parse_list(const string& values)
+    {
+        vector<T> list;
+        stringstream stream(values);
+        string value;
+        while (getline(stream, value, ','))
+        {
+            if (!value.empty())
+            {
+                list.push_back(static_cast<T>(stod(value)));
+            }
+        }
+        return list;
+    }
+
+    // Sets one option, returns false if the key is unknown
+    bool set_option(SweepOptions& options, const string& key, const string& value)
+    {
+        if (key == "sweep" || key == "instance")
+        {
+            options.instance = value;
+        }
+        else if (key == "w")
+        {
+            options.w = parse_list<double>(value);
+        }
+        else if (key == "c1")
+        {
+            options.c1 = parse_list<double>(value);
+        }
+        else if (key == "c2")
+        {
+            options.c2 = parse_list<double>(value);
+        }
+        else if (key == "particles")
+        {
+            options.particles = parse_list<size_t>(value);
+        }
+        else if (key == "iterations")
+        {
+            options.iterations = parse_list<size_t>(value);
+        }
+        else if (key == "seeds")
+        {
+            options.seeds = max<size_t>(1, stoull(value));
+        }
+        else if (key == "samples")
+        {
+            options.samples = stoull(value);
+        }
+        else if (key == "csv")
+        {
+            options.csv_path = value;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    string trim(const string& s)
+    {
+        size_t first = s.find_first_not_of(" \t\r");
+        size_t last = s.find_last_not_of(" \t\r");
+        return first == string::npos ? "" : s.substr(first, last - first + 1);
+    }
+
+    void load_config(SweepOptions& options, const string& path)
+    {
+        ifstream file(path);
+        if (!file.is_open())
+        {
+            cerr << "Could not open the sweep config " << path << endl;
+            exit(1);
+        }
+
+        string line;
+        while (getline(file, line))
+        {
+            line = trim(line.substr(0, line.find('#')));
+            size_t equals = line.find('=');
+            if (line.empty())
+            {
+                continue;
+            }
+            if (equals == string::npos || !set_option(options, trim(line.substr(0, equals)), trim(line.substr(equals + 1))))
+            {
+                cerr << "Unknown sweep config line: " << line << endl;
+                exit(1);
+            }
+        }
+    }
+
+    template <class T>
+    T draw(Xoshiro256& rng, const vector<T>& values)
+    {
+        auto bounds = minmax_element(values.begin(), values.end());
+        double value = *bounds.first + rng.uniform() * (*bounds.second - *bounds.first);
+        return is_integral<T>::value ? static_cast<T>(llround(value)) : static_cast<T>(value);
+    }
+
+    // Parameters of a configuration without its seed, the runs of one configuration share them
+    tuple<double, double, double, size_t, size_t> parameters(const SweepConfig& config)
+    {
+        return make_tuple(config.w, config.c1, config.c2, config.num_particles, config.num_iterations);
+    }
+}
+
+
+SweepOptions parse_sweep_options(int argc, char* argv[])
+{
+    SweepOptions options;
+    options.seed = master_seed();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--config" && has_value)
+        {
+            load_config(options, argv[++i]);
+        }
+        else if (arg.rfind("--", 0) == 0 && has_value && set_option(options, arg.substr(2), argv[i + 1]))
+        {
+            ++i;
+        }
+        else
+        {
+            cerr << usage << endl;
+            exit(1);
+        }
+    }
+
+    if (options.instance.empty() || options.w.empty() || options.c1.empty() || options.c2.empty()
+        || options.particles.empty() || options.iterations.empty())
+    {
+        cerr << usage << endl;
+        exit(1);
+    }
+
+    // A swarm needs a particle and a run an iteration
+    for (auto& n : options.particles)
+    {
+        n = max<size_t>(1, n);
+    }
+    for (auto& n : options.iterations)
+    {
+        n = max<size_t>(1, n);
+    }
+    return options;
+}
+
+
+vector<SweepConfig> sweep_configs(const SweepOptions& options)
+{
+    // Seed k is the same for every configuration, so configurations are compared on the same random streams
+    Xoshiro256 streams(options.seed);
+    vector<uint64_t> seeds;
+    for (size_t k = 0; k < options.seeds; ++k)
+    {
+        seeds.push_back(streams.split()());
+    }
+
+    vector<SweepConfig> grid;
+    if (options.samples > 0)
+    {
+        Xoshiro256 rng = streams.split();
+        for (size_t s = 0; s < options.samples; ++s)
+        {
+            grid.push_back(SweepConfig{ draw(rng, options.w), draw(rng, options.c1), draw(rng, options.c2),
+                draw(rng, options.particles), draw(rng, options.iterations), 0 });
+        }
+    }
+    else
+    {
+        for (double w : options.w)
+            for (double c1 : options.c1)
+                for (double c2 : options.c2)
+                    for (size_t particles : options.particles)
+                        for (size_t iterations : options.iterations)
+                        {
+                            grid.push_back(SweepConfig{ w, c1, c2, particles, iterations, 0 });
+                        }
+    }
+
+    vector<SweepConfig> configs;
+    for (const auto& config : grid)
+    {
+        for (uint64_t seed : seeds)
+        {
+            configs.push_back(config);
+            configs.back().seed = seed;
+        }
+    }
+    return configs;
+}
+
+
+vector<SweepResult> run_sweep(const vector<SweepConfig>& configs, const InstanceContext& context,
+    size_t num_cities, size_t num_items, double capacity, double v_max, double v_min, double rent_rate,
+    LocalSearchMode local_search, ThreadPool& pool)
+{
+    vector<SweepResult> results(configs.size());
+
+    // The swarms share the instance read-only, and their particle loops share the pool with the other runs
+    pool.parallel_for(0, configs.size(), [&](size_t i) {
+        const SweepConfig& config = configs[i];
+        auto start = chrono::steady_clock::now();
+
+        PSO pso(config.num_particles, context, num_cities, num_items, capacity, v_max, v_min, rent_rate,
+            local_search, config.seed, Deadline(), pool);
+        const ParetoArchive& front = pso.run(config.num_iterations, config.w, config.c1, config.c2);
+
+        SweepResult& result = results[i];
+        result.config = config;
+        result.best_fitness = pso.best_fitness();
+        result.front_size = front.size();
+        result.front = front;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    });
+
+    // Fronts are only comparable against one reference point
+    double ref_time = context.reference_time(v_min);
+    for (auto& result : results)
+    {
+        result.hypervolume = result.front.hypervolume(ref_time, 0);
+    }
+    return results;
+}
+
+
+void print_sweep_summary(ostream& out, const vector<SweepResult>& results)
+{
+    struct Summary {
+        size_t runs = 0;
+        double hypervolume = 0;
+        double best_hypervolume = 0;
+        double fitness = 0;
+        double best_fitness = -1e300;
+        double seconds = 0;
+    };
+
+    map<tuple<double, double, double, size_t, size_t>, Summary> summaries;
+    for (const auto& result : results)
+    {
+        Summary& summary = summaries[parameters(result.config)];
+        summary.runs++;
+        summary.hypervolume += result.hypervolume;
+        summary.best_hypervolume = max(summary.best_hypervolume, result.hypervolume);
+        summary.fitness += result.best_fitness;
+        summary.best_fitness = max(summary.best_fitness, result.best_fitness);
+        summary.seconds += result.seconds;
+    }
+
+    vector<pair<tuple<double, double, double, size_t, size_t>, Summary>> rows(summaries.begin(), summaries.end());
+    stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.hypervolume / a.second.runs > b.second.hypervolume / b.second.runs;
+    });
+
+    out << right << setw(6) << "w" << setw(6) << "c1" << setw(6) << "c2" << setw(11) << "particles" << setw(12)
+        << "iterations" << setw(6) << "runs" << setw(16) << "mean hv" << setw(16) << "best hv" << setw(16)
+        << "mean fitness" << setw(16) << "best fitness" << setw(12) << "mean s" << endl;
+    for (const auto& row : rows)
+    {
+        const Summary& s = row.second;
+        out << fixed << setprecision(2) << setw(6) << get<0>(row.first) << setw(6) << get<1>(row.first) << setw(6)
+            << get<2>(row.first) << setw(11) << get<3>(row.first) << setw(12) << get<4>(row.first) << setw(6) << s.runs
+            << setprecision(1) << setw(16) << s.hypervolume / s.runs << setw(16) << s.best_hypervolume
+            << setw(16) << s.fitness / s.runs << setw(16) << s.best_fitness
+            << setprecision(3) << setw(12) << s.seconds / s.runs << endl;
+    }
+    out << defaultfloat;
+}
+
+
+bool write_sweep_csv(const string& path, const vector<SweepResult>& results)
+{
+    ostringstream csv;
+    csv << setprecision(10) << "w,c1,c2,particles,iterations,seed,best_fitness,front_size,hypervolume,seconds\n";
+    for (const auto& r : results)
+    {
+        csv << r.config.w << ',' << r.config.c1 << ',' << r.config.c2 << ',' << r.config.num_particles << ','
+            << r.config.num_iterations << ',' << r.config.seed << ',' << r.best_fitness << ',' << r.front_size << ','
+            << r.hypervolume << ',' << r.seconds << "\n";
+    }
+    return write_file_atomic(path, csv.str());
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "HelperClasses.h"
+
+using namespace std;
+
+/// <summary>
+/// One PSO configuration of a sweep
+/// </summary>
+struct SweepConfig {
+    double w;
+    double c1;
+    double c2;
+    size_t num_particles;
+    size_t num_iterations;
+    uint64_t seed;
+};
+
+/// <summary>
+/// Values of every parameter of a sweep, from the command line or a config file
+/// </summary>
+struct SweepOptions {
+    // Instance to sweep over
+    string instance;
+
+    vector<double> w{ 0.9 };
+    vector<double> c1{ 1.4 };
+    vector<double> c2{ 1.5 };
+    vector<size_t> particles{ 20 };
+    vector<size_t> iterations{ 2 };
+
+    // Runs of every configuration, each with its own seed. Run k of every configuration uses the same seed.
+    size_t seeds = 1;
+
+    // Random configurations drawn between the smallest and largest value of every parameter, 0 runs the grid
+    size_t samples = 0;
+
+    // Master seed of the sweep
+    uint64_t seed = 0;
+
+    // Per-run results as CSV, empty writes results/<instance>.sweep.csv
+    string csv_path;
+};
+
+/// <summary>
+/// Result of one run of a sweep
+/// </summary>
+struct SweepResult {
+    SweepConfig config;
+    double best_fitness;
+    size_t front_size;
+
+    // Hypervolume of the front against the reference point shared by all runs of the sweep
+    double hypervolume;
+
+    // Wall time of the run, the runs share the cores so times are comparable within one sweep only
+    double seconds;
+
+    ParetoArchive front;
+};
+
+/// <summary>
+/// Parses the sweep options: --sweep instance, a comma separated list of values for --w, --c1, --c2,
+/// --particles and --iterations, --seeds N, --samples N, --csv file and --config file. A config file
+/// holds one "key = values" line per option, with the same keys without the dashes.
+/// </summary>
+SweepOptions parse_sweep_options(int argc, char* argv[]);
+
+/// <summary>
+/// Configurations of a sweep: the full grid of all the values or a random sample, each run with every seed
+/// </summary>
+vector<SweepConfig> sweep_configs(const SweepOptions& options);
+
+/// <summary>
+/// Runs every configuration on the same loaded instance, concurrently on the pool, and computes the
+/// hypervolume of every front against the reference time of the instance and zero profit
+/// </summary>
+vector<SweepResult> run_sweep(const vector<SweepConfig>& configs, const InstanceContext& context,
+    size_t num_cities, size_t num_items, double capacity, double v_max, double v_min, double rent_rate,
+    LocalSearchMode local_search,
+    ThreadPool& pool = ThreadPool::instance());
+
+/// <summary>
+/// Prints one row per configuration with the mean and best hypervolume and fitness over its seeds and its
+/// mean time, best mean hypervolume first
+/// </summary>
+void print_sweep_summary(ostream& out, const vector<SweepResult>& results);
+
+/// <summary>
+/// Writes one CSV row per run
+/// </summary>
+bool write_sweep_csv(const string& path, const vector<SweepResult>& results);
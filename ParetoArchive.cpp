@@ -0,0 +1,117 @@
+#include "ParetoArchive.h"
+
+NodePool::~NodePool()
+{
+    while (free_list != nullptr)
+    {
+        FreeBlock* next = free_list->next;
+        ::operator delete(free_list);
+        free_list = next;
+    }
+}
+
+
+void* NodePool::allocate(size_t block_size)
+{
+    if (size == 0)
+    {
+        size = block_size;
+    }
+    if (free_list == nullptr)
+    {
+        return ::operator new(size);
+    }
+    FreeBlock* block = free_list;
+    free_list = block->next;
+    num_free--;
+    return block;
+}
+
+
+void NodePool::deallocate(void* block)
+{
+    FreeBlock* free_block = static_cast<FreeBlock*>(block);
+    free_block->next = free_list;
+    free_list = free_block;
+    num_free++;
+}
+
+
+bool ParetoArchive::dominated(double time, double profit) const
+{
+    // The fastest point with a time up to the new one has the highest profit among them
+    auto it = front.upper_bound(time);
+    if (it == front.begin())
+    {
+        return false;
+    }
+    --it;
+    return it->second >= profit;
+}
+
+
+bool ParetoArchive::insert(double time, double profit)
+{
+    if (dominated(time, profit))
+    {
+        return false;
+    }
+
+    // Remove the slower points that are not more profitable, they follow the new point in the map
+    auto it = front.lower_bound(time);
+    while (it != front.end() && it->second <= profit)
+    {
+        it = front.erase(it);
+    }
+
+    front.emplace_hint(it, time, profit);
+    return true;
+}
+
+
+void ParetoArchive::merge(const ParetoArchive& other)
+{
+    for (const auto& point : other.front)
+    {
+        insert(point.first, point.second);
+    }
+}
+
+
+void ParetoArchive::reserve(size_t num_points)
+{
+    size_t held = front.size() + front.get_allocator().node_pool().available();
+    if (num_points <= held)
+    {
+        return;
+    }
+
+    // A map on the same pool allocates the missing nodes and gives them back to the pool when it goes away
+    Front nodes(front.get_allocator());
+    for (size_t i = 0; i < num_points - held; ++i)
+    {
+        nodes.emplace_hint(nodes.end(), static_cast<double>(i), 0.0);
+    }
+}
+
+
+double ParetoArchive::hypervolume(double reference_time, double reference_profit) const
+{
+    // Profit levels between two consecutive points are reached first by the slower one of the two
+    double volume = 0.0;
+    double previous_profit = reference_profit;
+    for (const auto& point : front)
+    {
+        if (point.first >= reference_time)
+        {
+            break;
+        }
+        if (point.second > previous_profit)
+        {
+            volume += (reference_time - point.first) * (point.second - previous_profit);
+            previous_profit = point.second;
+        }
+    }
+    return volume;
+}
+
@@ -0,0 +1,153 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+
+using namespace std;
+
+/// <summary>
+/// Free list of equally sized memory blocks. Blocks are taken from the global operator new when the list
+/// is empty and only released when the pool is destroyed.
+/// </summary>
+class NodePool {
+public:
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+    ~NodePool();
+
+    /// <summary>
+    /// Block of block_size bytes, the size is fixed by the first call
+    /// </summary>
+    void* allocate(size_t block_size);
+
+    void deallocate(void* block);
+
+    /// <summary>
+    /// Number of blocks in the free list
+    /// </summary>
+    inline size_t available() const { return num_free; }
+
+private:
+
+    // Freed blocks are chained through their first bytes
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    FreeBlock* free_list = nullptr;
+    size_t num_free = 0;
+    size_t size = 0;
+};
+
+/// <summary>
+/// Allocator of single container nodes from a shared NodePool, larger requests go to the global operator new.
+/// A copy of a container gets a pool of its own, so containers on different threads never share one.
+/// </summary>
+template <class T>
+class PoolAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = true_type;
+    using propagate_on_container_swap = true_type;
+
+    PoolAllocator() : pool(make_shared<NodePool>()) {}
+
+    // A moved allocator must still compare equal to its source, so moves copy the pool pointer
+    PoolAllocator(const PoolAllocator&) = default;
+    PoolAllocator& operator=(const PoolAllocator&) = default;
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t n)
+    {
+        if (n == 1 && sizeof(T) >= sizeof(void*))
+        {
+            return static_cast<T*>(pool->allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (n == 1 && sizeof(T) >= sizeof(void*))
+        {
+            pool->deallocate(p);
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    PoolAllocator select_on_container_copy_construction() const { return PoolAllocator(); }
+
+    inline const NodePool& node_pool() const { return *pool; }
+
+    template <class U>
+    bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+
+    template <class U>
+    bool operator!=(const PoolAllocator<U>& other) const { return pool != other.pool; }
+
+private:
+    template <class U> friend class PoolAllocator;
+
+    shared_ptr<NodePool> pool;
+};
+
+/// <summary>
+/// Non-dominated front of (travel time, profit) solutions, with the travel time minimised and the profit
+/// maximised. The front is kept in a map ordered by travel time, where the profit strictly increases with
+/// the time, so an insert is one O(log n) lookup plus the removal of the points it dominates. The nodes of
+/// the map come from a pool that keeps the removed ones, so an insert only allocates when the front
+/// outgrows its largest size so far, or the size given to reserve.
+/// </summary>
+class ParetoArchive {
+public:
+    using Front = map<double, double, less<double>, PoolAllocator<pair<const double, double>>>;
+    using const_iterator = Front::const_iterator;
+
+    /// <summary>
+    /// Adds a solution to the front, returns false if it is dominated by (or equal to) a point of the front
+    /// </summary>
+    bool insert(double time, double profit);
+
+    /// <summary>
+    /// True if a point of the front is at least as fast and at least as profitable
+    /// </summary>
+    bool dominated(double time, double profit) const;
+
+    /// <summary>
+    /// Adds all the points of another front
+    /// </summary>
+    void merge(const ParetoArchive& other);
+
+    /// <summary>
+    /// Allocates the nodes of a front of up to num_points points in advance
+    /// </summary>
+    void reserve(size_t num_points);
+
+    /// <summary>
+    /// Area dominated by the front and bounded by the reference point, the slowest time and the lowest profit
+    /// </summary>
+    double hypervolume(double reference_time, double reference_profit) const;
+
+    inline size_t size() const { return front.size(); }
+
+    inline bool empty() const { return front.empty(); }
+
+    inline void clear() { front.clear(); }
+
+    /// <summary>
+    /// Points of the front as (time, profit), ordered by increasing time and profit
+    /// </summary>
+    inline const_iterator begin() const { return front.begin(); }
+
+    inline const_iterator end() const { return front.end(); }
+
+private:
+
+    // Travel time to profit, profits strictly increase with the time
+    Front front;
+};
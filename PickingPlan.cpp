@@ -0,0 +1,81 @@
+#include "PickingPlan.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+static inline int popcount64(uint64_t x) { return static_cast<int>(__popcnt64(x)); }
+
+static inline int ctz64(uint64_t x)
+{
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+}
+#else
+static inline int popcount64(uint64_t x) { return __builtin_popcountll(x); }
+
+static inline int ctz64(uint64_t x) { return __builtin_ctzll(x); }
+#endif
+
+void PickingPlan::clear()
+{
+    fill(words.begin(), words.end(), 0);
+}
+
+
+size_t PickingPlan::count() const
+{
+    size_t total = 0;
+    for (uint64_t word : words)
+    {
+        total += popcount64(word);
+    }
+    return total;
+}
+
+
+long long masked_sum(const PickingPlan& plan, const int* values)
+{
+    const uint64_t* words = plan.data();
+    size_t full_words = plan.size() / 64;
+    long long total = 0;
+
+    for (size_t w = 0; w < full_words; ++w)
+    {
+        uint64_t bits = words[w];
+        const int* block = values + w * 64;
+
+        if (popcount64(bits) < 8)
+        {
+            // Few picked items, visit the set bits only
+            while (bits != 0)
+            {
+                total += block[ctz64(bits)];
+                bits &= bits - 1;
+            }
+        }
+        else
+        {
+            // Dense word, mask every value with its bit
+            long long partial = 0;
+            for (int b = 0; b < 64; ++b)
+            {
+                partial += block[b] & -static_cast<int>((bits >> b) & 1);
+            }
+            total += partial;
+        }
+    }
+
+    // Remaining items of the last, partial word
+    for (size_t i = full_words * 64; i < plan.size(); ++i)
+    {
+        if (plan[i])
+        {
+            total += values[i];
+        }
+    }
+
+    return total;
+}
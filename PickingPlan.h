@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/// <summary>
+/// Picking plan stored as a packed bitset, one bit per item instead of a double. Copying and comparing
+/// plans moves 64 times less memory and the masked sums below run over whole words.
+/// </summary>
+class PickingPlan {
+public:
+    PickingPlan(size_t num_items = 0)
+        :num_items(num_items), words((num_items + 63) / 64, 0)
+    {
+    }
+
+    inline size_t size() const { return num_items; }
+
+    /// <summary>
+    /// Returns true if the item is picked
+    /// </summary>
+    inline bool operator[](size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+
+    inline void set(size_t i, bool picked)
+    {
+        uint64_t mask = uint64_t(1) << (i & 63);
+        words[i >> 6] = picked ? (words[i >> 6] | mask) : (words[i >> 6] & ~mask);
+    }
+
+    inline void flip(size_t i) { words[i >> 6] ^= uint64_t(1) << (i & 63); }
+
+    /// <summary>
+    /// Unpicks all the items
+    /// </summary>
+    void clear();
+
+    /// <summary>
+    /// Number of picked items
+    /// </summary>
+    size_t count() const;
+
+    inline const uint64_t* data() const { return words.data(); }
+
+    inline uint64_t* data() { return words.data(); }
+
+    inline size_t num_words() const { return words.size(); }
+
+    inline bool operator==(const PickingPlan& other) const { return num_items == other.num_items && words == other.words; }
+
+    inline bool operator!=(const PickingPlan& other) const { return !(*this == other); }
+
+private:
+
+    // Number of items in the plan
+    size_t num_items;
+
+    // Packed bits, item i is bit i % 64 of word i / 64
+    vector<uint64_t> words;
+};
+
+
+/// <summary>
+/// Sum of values[i] over the picked items. Sparse words walk their set bits, dense words use a
+/// branch-free masked loop the compiler can vectorise.
+/// </summary>
+/// <param name="plan"></param>
+/// <param name="values">One value per item of the plan</param>
+/// <returns>long long</returns>
+long long masked_sum(const PickingPlan& plan, const int* values);
@@ -0,0 +1,168 @@
+#include "Profiler.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include "HelperFunctions.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace {
+    const char* phase_names[] = {
+        "load", "parse", "preprocess", "initialise", "run", "evaluate", "update",
+        "local_search", "two_opt", "bit_flip", "tour_engine", "checkpoint" };
+
+    const char* counter_names[] = {
+        "evaluations", "position_updates", "two_opt_tried", "two_opt_applied",
+        "bit_flip_screened", "bit_flip_batches", "bit_flip_applied",
+        "tour_engine_tried", "lin_kernighan_applied", "or_opt_applied" };
+
+    static_assert(sizeof(phase_names) / sizeof(phase_names[0]) == static_cast<size_t>(Phase::Count), "phase names");
+    // Profiler bound to the thread, the process profiler is used if it is null
+    thread_local Profiler* bound_profiler = nullptr;
+
+    static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == static_cast<size_t>(Counter::Count), "counter names");
+}
+
+
+Profiler::Profiler()
+{
+    reset();
+}
+
+
+Profiler& Profiler::instance()
+{
+    if (bound_profiler != nullptr)
+    {
+        return *bound_profiler;
+    }
+
+    static Profiler profiler;
+    return profiler;
+}
+
+
+Profiler* Profiler::bind(Profiler* profiler)
+{
+    Profiler* previous = bound_profiler;
+    bound_profiler = profiler;
+    return previous;
+}
+
+
+void Profiler::reset()
+{
+    for (size_t p = 0; p < static_cast<size_t>(Phase::Count); ++p)
+    {
+        calls[p].store(0, memory_order_relaxed);
+        wall[p].store(0, memory_order_relaxed);
+        cpu[p].store(0, memory_order_relaxed);
+    }
+    for (auto& c : counters)
+    {
+        c.store(0, memory_order_relaxed);
+    }
+}
+
+
+#ifdef _WIN32
+uint64_t Profiler::thread_cpu_ns()
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    {
+        return 0;
+    }
+
+    // FILETIME counts 100 ns intervals
+    uint64_t k = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+    uint64_t u = (static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+    return (k + u) * 100;
+}
+
+
+size_t Profiler::peak_memory()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+}
+#else
+uint64_t Profiler::thread_cpu_ns()
+{
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+
+size_t Profiler::peak_memory()
+{
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+    // ru_maxrss is in bytes on macOS and in kilobytes elsewhere
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+#endif
+
+
+bool Profiler::write_json(const string& path, const string& instance, uint64_t seed, size_t threads, double total_seconds) const
+{
+    // Evaluations per second of the whole run, the initialisation included
+    double evaluations = static_cast<double>(count(Counter::Evaluations));
+    double run_seconds = wall_seconds(Phase::Run) + wall_seconds(Phase::Initialise);
+
+    ostringstream report;
+    report << setprecision(9);
+    report << "{\n";
+    report << "  \"instance\": \"" << json_escape(instance) << "\",\n";
+    report << "  \"seed\": " << seed << ",\n";
+    report << "  \"threads\": " << threads << ",\n";
+    report << "  \"total_seconds\": " << total_seconds << ",\n";
+    report << "  \"evaluations_per_second\": " << (run_seconds > 0 ? evaluations / run_seconds : 0.0) << ",\n";
+    report << "  \"peak_memory_bytes\": " << peak_memory() << ",\n";
+
+    report << "  \"phases\": {\n";
+    for (size_t p = 0; p < static_cast<size_t>(Phase::Count); ++p)
+    {
+        Phase phase = static_cast<Phase>(p);
+        report << "    \"" << phase_names[p] << "\": {\"calls\": " << num_calls(phase)
+            << ", \"wall_seconds\": " << wall_seconds(phase) << ", \"cpu_seconds\": " << cpu_seconds(phase) << "}"
+            << (p + 1 < static_cast<size_t>(Phase::Count) ? "," : "") << "\n";
+    }
+    report << "  },\n";
+
+    report << "  \"counters\": {\n";
+    for (size_t c = 0; c < static_cast<size_t>(Counter::Count); ++c)
+    {
+        report << "    \"" << counter_names[c] << "\": " << count(static_cast<Counter>(c))
+            << (c + 1 < static_cast<size_t>(Counter::Count) ? "," : "") << "\n";
+    }
+    report << "  }\n";
+    report << "}\n";
+
+    // Readers of the report never see a half written file
+    return write_file_atomic(path, report.str());
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Timed phases of a run
+enum class Phase {
+    Load,
+    Parse,
+    Preprocess,
+    Initialise,
+    Run,
+    Evaluate,
+    Update,
+    LocalSearch,
+    TwoOpt,
+    BitFlip,
+    TourEngine,
+    Checkpoint,
+    Count
+};
+
+// Event counters of a run
+enum class Counter {
+    Evaluations,
+    PositionUpdates,
+    TwoOptTried,
+    TwoOptApplied,
+    BitFlipScreened,
+    BitFlipBatches,
+    BitFlipApplied,
+    TourEngineTried,
+    LinKernighanApplied,
+    OrOptApplied,
+    Count
+};
+
+/// <summary>
+/// Phase timers and event counters. Phases and counters are accumulated with relaxed atomics, once per
+/// timed call and once per local search, so they stay cheap enough to be always on. Times are summed over
+/// all calls on all threads, so a phase run in parallel can take more time than the run itself. Instances
+/// run concurrently each bind their own profiler to their threads.
+/// </summary>
+class Profiler {
+public:
+    Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    /// <summary>
+    /// Profiler bound to the calling thread, the profiler of the process if none is bound
+    /// </summary>
+    static Profiler& instance();
+
+    /// <summary>
+    /// Binds a profiler to the calling thread, null unbinds it. Returns the previously bound profiler.
+    /// </summary>
+    static Profiler* bind(Profiler* profiler);
+
+    /// <summary>
+    /// Clears all timers and counters, called at the start of every instance
+    /// </summary>
+    void reset();
+
+    inline void add_time(Phase phase, uint64_t wall_ns, uint64_t cpu_ns)
+    {
+        size_t p = static_cast<size_t>(phase);
+        calls[p].fetch_add(1, memory_order_relaxed);
+        wall[p].fetch_add(wall_ns, memory_order_relaxed);
+        cpu[p].fetch_add(cpu_ns, memory_order_relaxed);
+    }
+
+    inline void add(Counter counter, uint64_t n = 1)
+    {
+        counters[static_cast<size_t>(counter)].fetch_add(n, memory_order_relaxed);
+    }
+
+    inline uint64_t count(Counter counter) const { return counters[static_cast<size_t>(counter)].load(memory_order_relaxed); }
+
+    inline uint64_t num_calls(Phase phase) const { return calls[static_cast<size_t>(phase)].load(memory_order_relaxed); }
+
+    inline double wall_seconds(Phase phase) const { return wall[static_cast<size_t>(phase)].load(memory_order_relaxed) * 1e-9; }
+
+    inline double cpu_seconds(Phase phase) const { return cpu[static_cast<size_t>(phase)].load(memory_order_relaxed) * 1e-9; }
+
+    /// <summary>
+    /// CPU time of the calling thread in nanoseconds
+    /// </summary>
+    static uint64_t thread_cpu_ns();
+
+    /// <summary>
+    /// Peak resident memory of the process in bytes, over the whole process lifetime
+    /// </summary>
+    static size_t peak_memory();
+
+    /// <summary>
+    /// Writes the phases, counters, evaluations per second and peak memory as a JSON report. The report
+    /// is written to a temporary file that is renamed into place.
+    /// </summary>
+    bool write_json(const string& path, const string& instance, uint64_t seed, size_t threads, double total_seconds) const;
+
+private:
+
+    atomic<uint64_t> calls[static_cast<size_t>(Phase::Count)];
+    atomic<uint64_t> wall[static_cast<size_t>(Phase::Count)];
+    atomic<uint64_t> cpu[static_cast<size_t>(Phase::Count)];
+    atomic<uint64_t> counters[static_cast<size_t>(Counter::Count)];
+};
+
+/// <summary>
+/// Binds a profiler to the calling thread for its scope
+/// </summary>
+class ProfilerBinding {
+public:
+    explicit ProfilerBinding(Profiler& profiler) :previous(Profiler::bind(&profiler)) {}
+
+    ~ProfilerBinding() { Profiler::bind(previous); }
+
+    ProfilerBinding(const ProfilerBinding&) = delete;
+    ProfilerBinding& operator=(const ProfilerBinding&) = delete;
+
+private:
+
+    Profiler* previous;
+};
+
+/// <summary>
+/// Adds the wall and thread CPU time of its scope to a phase of the profiler of the thread
+/// </summary>
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Phase phase)
+        :phase(phase), wall_start(chrono::steady_clock::now()), cpu_start(Profiler::thread_cpu_ns())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        uint64_t wall_ns = static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - wall_start).count());
+        Profiler::instance().add_time(phase, wall_ns, Profiler::thread_cpu_ns() - cpu_start);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+
+    Phase phase;
+    chrono::steady_clock::time_point wall_start;
+    uint64_t cpu_start;
+};
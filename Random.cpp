@@ -0,0 +1,107 @@
+#include "Random.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace {
+    // splitmix64 step, spreads a 64-bit seed over the generator state
+    uint64_t splitmix64(uint64_t& x)
+    {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+}
+
+
+Xoshiro256::Xoshiro256(uint64_t seed)
+{
+    for (auto& s : state)
+    {
+        s = splitmix64(seed);
+    }
+}
+
+
+void Xoshiro256::fill_uniform(double* out, size_t count)
+{
+    // Local copy of the state, so the loop keeps it in registers
+    Xoshiro256 g = *this;
+    for (size_t i = 0; i < count; ++i)
+    {
+        out[i] = g.uniform();
+    }
+    *this = g;
+}
+
+
+void Xoshiro256::jump()
+{
+    static const uint64_t polynomial[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+
+    uint64_t s[4] = { 0, 0, 0, 0 };
+    for (uint64_t word : polynomial)
+    {
+        for (int b = 0; b < 64; ++b)
+        {
+            if (word & (1ULL << b))
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    s[i] ^= state[i];
+                }
+            }
+            (*this)();
+        }
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        state[i] = s[i];
+    }
+}
+
+
+Xoshiro256 Xoshiro256::split()
+{
+    Xoshiro256 stream = *this;
+    jump();
+    return stream;
+}
+
+
+uint64_t master_seed()
+{
+    static const uint64_t seed = []() {
+        const char* env = getenv("PSO_SEED");
+        if (env != nullptr)
+        {
+            return static_cast<uint64_t>(stoull(env));
+        }
+
+        random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    }();
+    return seed;
+}
+
+
+Xoshiro256& thread_rng()
+{
+    // Thread streams are taken from their own branch of the master seed, away from the particle streams
+    static atomic<uint64_t> next_stream(0);
+
+    thread_local Xoshiro256 rng = []() {
+        Xoshiro256 g(master_seed() ^ 0x5851f42d4c957f2dULL);
+        for (uint64_t i = next_stream++; i > 0; --i)
+        {
+            g.jump();
+        }
+        return g;
+    }();
+    return rng;
+}
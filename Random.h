@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/// <summary>
+/// xoshiro256** pseudo-random generator, seeded through splitmix64. It is small enough to live in every
+/// particle and thread, and jump() advances it by 2^128 steps, so independent streams are split from one
+/// master seed without overlapping. It satisfies UniformRandomBitGenerator and works with the std algorithms.
+/// </summary>
+class Xoshiro256 {
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed);
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    inline result_type operator()()
+    {
+        const uint64_t result = rotl(state[1] * 5, 7) * 9;
+        const uint64_t t = state[1] << 17;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+
+        return result;
+    }
+
+    /// <summary>
+    /// Uniform double in [0, 1), from the top 53 bits of the next output
+    /// </summary>
+    inline double uniform() { return static_cast<double>((*this)() >> 11) * 0x1.0p-53; }
+
+    /// <summary>
+    /// Fills a buffer with uniform doubles in [0, 1)
+    /// </summary>
+    void fill_uniform(double* out, size_t count);
+
+    /// <summary>
+    /// Advances the generator by 2^128 steps
+    /// </summary>
+    void jump();
+
+    /// <summary>
+    /// Returns a copy of the generator and jumps this one past it, the copy is an independent stream
+    /// </summary>
+    Xoshiro256 split();
+
+    /// <summary>
+    /// State of the generator, a generator restored from it continues the same stream
+    /// </summary>
+    inline array<uint64_t, 4> get_state() const { return { state[0], state[1], state[2], state[3] }; }
+
+    inline void set_state(const array<uint64_t, 4>& words)
+    {
+        for (size_t i = 0; i < 4; ++i)
+        {
+            state[i] = words[i];
+        }
+    }
+
+private:
+
+    static inline uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t state[4];
+};
+
+/// <summary>
+/// Master seed of the process, taken from the PSO_SEED environment variable or drawn once from random_device
+/// </summary>
+uint64_t master_seed();
+
+/// <summary>
+/// Generator of the calling thread. Every thread gets its own stream split from the master seed.
+/// </summary>
+Xoshiro256& thread_rng();
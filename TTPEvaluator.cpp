@@ -0,0 +1,205 @@
+#include "TTPEvaluator.h"
+
+#include <algorithm>
+#include <limits>
+
+TTPEvaluator::TTPEvaluator(const DistanceOracle& distances, const ItemStore& items, double capacity, double rent_rate,
+    double v_max, double v_min)
+    :distances(distances), items(items), total_profit(0), travel_time(0), total_weight(0), capacity(capacity),
+    rent_rate(rent_rate), v_max(v_max), v_min(v_min), nu((v_max - v_min) / capacity)
+{
+    size_t num_cities = items.num_cities();
+    position.resize(num_cities);
+    city_weight.resize(num_cities);
+    weight_at.resize(num_cities);
+    edge_length.resize(num_cities);
+    edge_time.resize(num_cities);
+    time_prefix.resize(num_cities + 1);
+    slope_suffix.resize(num_cities + 1);
+}
+
+
+size_t TTPEvaluator::repair(const vector<int>& tour, PickingPlan& plan) const
+{
+    if (static_cast<double>(masked_sum(plan, items.weight_data())) <= capacity)
+    {
+        return 0;
+    }
+
+    // Pick the planned items in tour order while they fit, drop the others
+    size_t dropped = 0;
+    double weight = 0;
+    for (int city : tour)
+    {
+        for (const int* item = items.city_begin(city); item != items.city_end(city); ++item)
+        {
+            if (!plan[*item])
+            {
+                continue;
+            }
+            if (weight + items.weight(*item) > capacity)
+            {
+                plan.set(*item, false);
+                dropped++;
+                continue;
+            }
+            weight += items.weight(*item);
+        }
+    }
+    return dropped;
+}
+
+
+void TTPEvaluator::build(const vector<int>& new_tour, const PickingPlan& plan)
+{
+    tour = new_tour;
+    size_t n = tour.size();
+
+    total_profit = 0;
+    total_weight = 0;
+    time_prefix[0] = 0;
+
+    // The tour loop runs on the distance source of the instance metric
+    distances.dispatch([&](const auto& distance) {
+        for (size_t k = 0; k < n; ++k)
+        {
+            int city = tour[k];
+            position[city] = k;
+            city_weight[city] = 0;
+
+            // Pick the planned items of the city
+            for (const int* item = items.city_begin(city); item != items.city_end(city); ++item)
+            {
+                int index = *item;
+                if (plan[index])
+                {
+                    double weight = items.weight(index);
+                    total_weight += weight;
+                    total_profit += items.profit(index);
+                    city_weight[city] += weight;
+                }
+            }
+
+            weight_at[k] = total_weight;
+            edge_length[k] = distance(city, tour[(k + 1) % n]);
+            edge_time[k] = edge_length[k] / speed(total_weight);
+            time_prefix[k + 1] = time_prefix[k] + edge_time[k];
+        }
+    });
+
+    travel_time = time_prefix[n];
+
+    slope_suffix[n] = 0;
+    for (size_t k = n; k-- > 0;)
+    {
+        double v = speed(weight_at[k]);
+        slope_suffix[k] = slope_suffix[k + 1] + edge_length[k] / (v * v);
+    }
+}
+
+
+double TTPEvaluator::flip_delta(size_t item_index, bool picked, bool approximate) const
+{
+    double weight = items.weight(item_index);
+    double profit = items.profit(item_index);
+
+    if (!picked && total_weight + weight > capacity)
+    {
+        return -numeric_limits<double>::infinity();
+    }
+
+    double dw = picked ? -weight : weight;
+    double dp = picked ? -profit : profit;
+    size_t p = position[items.node(item_index)];
+
+    double dt;
+    if (approximate)
+    {
+        // d(length / speed) / d(weight) = length * nu / speed^2 on every edge after the city
+        dt = dw * nu * slope_suffix[p];
+    }
+    else
+    {
+        double suffix_time = 0;
+        for (size_t k = p; k < tour.size(); ++k)
+        {
+            suffix_time += edge_length[k] / speed(weight_at[k] + dw);
+        }
+        dt = suffix_time - (travel_time - time_prefix[p]);
+    }
+
+    return dp - rent_rate * dt;
+}
+
+
+double TTPEvaluator::reverse_delta(size_t first, size_t last) const
+{
+    size_t n = tour.size();
+    if (first < 1 || first >= last || last >= n)
+    {
+        return 0.0;
+    }
+
+    // The weight carried before the segment and after it does not change, only the edges
+    // from position first - 1 up to last are travelled with different weights or lengths.
+    // The edges inside the segment keep their lengths, they are travelled the other way.
+    double entry_length = distances(tour[first - 1], tour[last]);
+    double exit_length = distances(tour[first], tour[(last + 1) % n]);
+
+    // Without a picked item in the segment the speed is the same on all these edges, only the
+    // two edges at the ends change
+    if (weight_at[last] == weight_at[first - 1])
+    {
+        double length_change = entry_length + exit_length - edge_length[first - 1] - edge_length[last];
+        return -rent_rate * length_change / speed(weight_at[first - 1]);
+    }
+
+    double weight = weight_at[first - 1];
+    double time = entry_length / speed(weight);
+    double old_time = edge_time[first - 1] + edge_time[last];
+    for (size_t k = last; k > first; --k)
+    {
+        weight += city_weight[tour[k]];
+        time += edge_length[k - 1] / speed(weight);
+        old_time += edge_time[k - 1];
+    }
+    weight += city_weight[tour[first]];
+    time += exit_length / speed(weight);
+    return -rent_rate * (time - old_time);
+}
+
+
+void TTPEvaluator::apply_reverse(size_t first, size_t last)
+{
+    size_t n = tour.size();
+    if (first < 1 || first >= last || last >= n)
+    {
+        return;
+    }
+
+    double old_time = 0;
+    for (size_t k = first - 1; k <= last; ++k)
+    {
+        old_time += edge_time[k];
+    }
+
+    // The inner edges are the same in reverse order, the two edges at the ends are new
+    reverse(tour.begin() + first, tour.begin() + last + 1);
+    reverse(edge_length.begin() + first, edge_length.begin() + last);
+    edge_length[first - 1] = distances(tour[first - 1], tour[first]);
+    edge_length[last] = distances(tour[last], tour[(last + 1) % n]);
+
+    double new_time = 0;
+    for (size_t k = first - 1; k <= last; ++k)
+    {
+        if (k >= first)
+        {
+            position[tour[k]] = k;
+            weight_at[k] = weight_at[k - 1] + city_weight[tour[k]];
+        }
+        edge_time[k] = edge_length[k] / speed(weight_at[k]);
+        new_time += edge_time[k];
+    }
+
+    travel_time += new_time - old_time;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+
+#include "DistanceOracle.h"
+#include "ItemStore.h"
+#include "PickingPlan.h"
+
+using namespace std;
+
+/// <summary>
+/// Incremental evaluator of the TTP objective, total profit - rent rate * travel time. A full build keeps
+/// per-position cumulative weight and travel time prefixes along the tour, so a single item flip is
+/// re-scored from the suffix after its city and a reversed tour segment from the segment alone.
+/// </summary>
+class TTPEvaluator {
+public:
+    TTPEvaluator(const DistanceOracle& distances, const ItemStore& items, double capacity, double rent_rate, double v_max, double v_min);
+
+    /// <summary>
+    /// Drops the planned items that do not fit in the knapsack any more when their city is reached along
+    /// the tour, so the plan fits as a whole. A plan whose total weight fits is left as it is, which is
+    /// checked with a masked sum over the words of the plan. Returns the number of items dropped.
+    /// </summary>
+    /// <param name="tour"></param>
+    /// <param name="plan"></param>
+    /// <returns>size_t</returns>
+    size_t repair(const vector<int>& tour, PickingPlan& plan) const;
+
+    /// <summary>
+    /// Evaluates the tour and picking plan from scratch. The plan must fit in the knapsack, see repair.
+    /// </summary>
+    /// <param name="tour"></param>
+    /// <param name="plan"></param>
+    void build(const vector<int>& tour, const PickingPlan& plan);
+
+    /// <summary>
+    /// Change of the objective when the item is flipped. The exact mode walks the suffix of the tour after the
+    /// item's city, the approximate mode is O(1) and uses the first-order change of the travel time.
+    /// Returns -infinity if picking the item exceeds the capacity. Needs a build after apply_reverse.
+    /// </summary>
+    /// <param name="item_index"></param>
+    /// <param name="picked">True if the item is currently in the plan</param>
+    /// <param name="approximate"></param>
+    /// <returns>double</returns>
+    double flip_delta(size_t item_index, bool picked, bool approximate) const;
+
+    /// <summary>
+    /// Change of the objective when the tour positions first..last are reversed, in O(last - first).
+    /// The first city of the tour is fixed, so first must be at least 1.
+    /// </summary>
+    /// <param name="first"></param>
+    /// <param name="last"></param>
+    /// <returns>double</returns>
+    double reverse_delta(size_t first, size_t last) const;
+
+    /// <summary>
+    /// Reverses the tour positions first..last and updates the weights, edges and travel time of the
+    /// segment in O(last - first), so reverse_delta stays exact for the next moves. The travel time prefixes
+    /// used by flip_delta are not updated.
+    /// </summary>
+    /// <param name="first"></param>
+    /// <param name="last"></param>
+    void apply_reverse(size_t first, size_t last);
+
+    inline double fitness() const { return total_profit - rent_rate * travel_time; }
+
+    inline double profit() const { return total_profit; }
+
+    inline double time() const { return travel_time; }
+
+    inline double weight() const { return total_weight; }
+
+private:
+
+    inline double speed(double weight) const
+    {
+        return (weight <= capacity) ? (v_max - weight * nu) : v_min;
+    }
+
+    const DistanceOracle& distances;
+
+    const ItemStore& items;
+
+    // Position of every city in the tour and the tour itself
+    vector<size_t> position;
+    vector<int> tour;
+
+    // Picked weight at every city
+    vector<double> city_weight;
+
+    // Weight after picking at position k, length of edge k (from position k to k + 1) and its travel time
+    vector<double> weight_at;
+    vector<double> edge_length;
+    vector<double> edge_time;
+
+    // Travel time before leaving position k, and suffix sums of length / speed^2 from position k on
+    vector<double> time_prefix;
+    vector<double> slope_suffix;
+
+    double total_profit, travel_time, total_weight;
+
+    double capacity, rent_rate, v_max, v_min;
+
+    // Speed lost per unit of weight
+    double nu;
+};
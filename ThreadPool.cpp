@@ -0,0 +1,315 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+    // Pool and queue index of the current thread, if it is a pool worker
+    thread_local ThreadPool* current_pool = nullptr;
+    thread_local size_t current_queue = 0;
+}
+
+
+ThreadPool::ThreadPool(size_t num_threads, const vector<int>& cpus, function<void()> thread_init)
+    :cpus(cpus), thread_init(move(thread_init)), pending(0), next_queue(0), stopping(false)
+{
+    // Every queue has room for the helpers of a loop started by its worker from the start
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        queues.push_back(make_unique<Queue>());
+        queues.back()->tasks.reserve(num_threads);
+    }
+
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        threads.emplace_back([this, i]() { worker_loop(i); });
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(sleep_mtx);
+        stopping = true;
+    }
+    wake_up.notify_all();
+
+    for (auto& t : threads)
+    {
+        if (t.joinable())
+        {
+            t.join();
+        }
+    }
+}
+
+
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool pool([]() {
+        // Number of workers from the environment, defaults to the hardware concurrency. PSO_THREADS is the
+        // core budget of the solver, which gives its instances pools of their own.
+        const char* env = getenv("PSO_POOL_THREADS");
+        if (env != nullptr && atoi(env) > 0)
+        {
+            return static_cast<size_t>(atoi(env));
+        }
+        return static_cast<size_t>(max(1u, thread::hardware_concurrency()));
+    }());
+
+    return pool;
+}
+
+
+void ThreadPool::push(function<void()> task)
+{
+    // Without workers the calling thread runs the task
+    if (queues.empty())
+    {
+        task();
+        return;
+    }
+
+    // Workers push to their own queue, other threads spread the tasks over all queues
+    size_t index = current_pool == this ? current_queue : next_queue.fetch_add(1) % queues.size();
+
+    {
+        lock_guard<mutex> lock(queues[index]->mtx);
+        queues[index]->tasks.push_back(move(task));
+    }
+
+    {
+        lock_guard<mutex> lock(sleep_mtx);
+        pending++;
+    }
+    wake_up.notify_one();
+}
+
+
+bool ThreadPool::run_one(size_t self)
+{
+    function<void()> task;
+
+    // Newest task from the own queue first
+    if (self < queues.size())
+    {
+        Queue& own = *queues[self];
+        lock_guard<mutex> lock(own.mtx);
+        if (own.tasks.size() > own.head)
+        {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            if (own.tasks.size() == own.head)
+            {
+                own.tasks.clear();
+                own.head = 0;
+            }
+        }
+    }
+
+    // Otherwise steal the oldest task of another worker
+    for (size_t k = 1; !task && k <= queues.size(); ++k)
+    {
+        size_t index = (self + k) % queues.size();
+        if (index == self)
+        {
+            continue;
+        }
+        Queue& victim = *queues[index];
+        lock_guard<mutex> lock(victim.mtx);
+        if (victim.tasks.size() > victim.head)
+        {
+            task = move(victim.tasks[victim.head++]);
+            if (victim.tasks.size() == victim.head)
+            {
+                victim.tasks.clear();
+                victim.head = 0;
+            }
+        }
+    }
+
+    if (!task)
+    {
+        return false;
+    }
+
+    pending--;
+    task();
+    return true;
+}
+
+
+bool ThreadPool::pin_current_thread(const vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+
+void ThreadPool::worker_loop(size_t index)
+{
+    current_pool = this;
+    current_queue = index;
+
+    if (!cpus.empty())
+    {
+        pin_current_thread(cpus);
+    }
+
+    if (thread_init)
+    {
+        thread_init();
+    }
+
+    while (true)
+    {
+        if (run_one(index))
+        {
+            continue;
+        }
+
+        unique_lock<mutex> lock(sleep_mtx);
+        wake_up.wait(lock, [this]() { return stopping || pending > 0; });
+        if (stopping && pending == 0)
+        {
+            return;
+        }
+    }
+}
+
+
+// Shared with the helper tasks. It lives on the stack of the calling thread, which waits until every
+// helper has left it.
+struct ThreadPool::Loop {
+    size_t begin;
+    size_t end;
+    size_t chunk_size;
+    size_t num_chunks;
+    const void* body;
+    LoopCall call;
+    atomic<size_t> next_chunk{ 0 };
+    atomic<size_t> helpers{ 0 };
+    mutex error_mtx;
+    exception_ptr error;
+};
+
+
+void ThreadPool::run_chunks(Loop& loop)
+{
+    size_t chunk;
+    while ((chunk = loop.next_chunk.fetch_add(1)) < loop.num_chunks)
+    {
+        size_t first = loop.begin + chunk * loop.chunk_size;
+        size_t last = min(loop.end, first + loop.chunk_size);
+        try
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                loop.call(loop.body, i);
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(loop.error_mtx);
+            if (!loop.error)
+            {
+                loop.error = current_exception();
+            }
+        }
+    }
+}
+
+
+void ThreadPool::run_loop(size_t begin, size_t end, size_t grain, const void* body, LoopCall call)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    size_t count = end - begin;
+    grain = max<size_t>(1, grain);
+
+    // Run small loops inline
+    if (count <= grain)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            call(body, i);
+        }
+        return;
+    }
+
+    // A few chunks per worker balances uneven iterations
+    size_t num_chunks = min((count + grain - 1) / grain, 4 * (size() + 1));
+    size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+    num_chunks = (count + chunk_size - 1) / chunk_size;
+
+    Loop loop;
+    loop.begin = begin;
+    loop.end = end;
+    loop.chunk_size = chunk_size;
+    loop.num_chunks = num_chunks;
+    loop.body = body;
+    loop.call = call;
+
+    // Helpers that start late find no chunk left. The task only holds two pointers, so the function
+    // wrapping it needs no heap storage.
+    size_t helpers = min(size(), num_chunks - 1);
+    loop.helpers = helpers;
+    Loop* shared = &loop;
+    for (size_t h = 0; h < helpers; ++h)
+    {
+        push([this, shared]() {
+            run_chunks(*shared);
+            // Last access to the loop, the caller may return as soon as it sees the count drop to 0.
+            // The count drops under the lock the caller waits with, so the wake up is not lost.
+            {
+                lock_guard<mutex> lock(sleep_mtx);
+                shared->helpers--;
+            }
+            wake_up.notify_all();
+        });
+    }
+
+    run_chunks(loop);
+
+    // Wait for every helper, running other tasks meanwhile. A helper that has not started yet may be
+    // run here, it finds no chunk left. With nothing to run, sleep until a task is pushed or a helper
+    // finishes. A thread outside the pool has no queue of its own and only steals.
+    size_t self = current_pool == this ? current_queue : queues.size();
+    while (loop.helpers > 0)
+    {
+        if (run_one(self))
+        {
+            continue;
+        }
+        unique_lock<mutex> lock(sleep_mtx);
+        wake_up.wait(lock, [&loop, this]() { return loop.helpers == 0 || pending > 0; });
+    }
+
+    if (loop.error)
+    {
+        rethrow_exception(loop.error);
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+/// <summary>
+/// Work-stealing thread pool. Every worker owns a task queue, runs its own tasks newest first and steals
+/// the oldest tasks of the other workers when it runs dry. The process-wide pool is sized to the hardware,
+/// the PSO_POOL_THREADS environment variable overrides the number of workers. A pool without workers runs every
+/// task and loop on the calling thread. A pool can be pinned to a set of CPUs, the island model gives every
+/// swarm its own pinned pool. An optional init function runs on every worker when it starts.
+/// </summary>
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t num_threads, const vector<int>& cpus = {}, function<void()> thread_init = nullptr);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// <summary>
+    /// Returns the process-wide pool
+    /// </summary>
+    static ThreadPool& instance();
+
+    /// <summary>
+    /// Restricts the calling thread to a set of CPUs, returns false if the platform does not support it
+    /// </summary>
+    static bool pin_current_thread(const vector<int>& cpus);
+
+    /// <summary>
+    /// Number of worker threads
+    /// </summary>
+    inline size_t size() const { return threads.size(); }
+
+    /// <summary>
+    /// Queues a task and returns a future for its result
+    /// </summary>
+    template <class F>
+    auto submit(F&& f) -> future<invoke_result_t<decay_t<F>>>
+    {
+        using result_type = invoke_result_t<decay_t<F>>;
+        auto task = make_shared<packaged_task<result_type()>>(forward<F>(f));
+        future<result_type> result = task->get_future();
+        push([task]() { (*task)(); });
+        return result;
+    }
+
+    /// <summary>
+    /// Runs body(i) for every i in [begin, end) and returns when all calls are done. The calling thread
+    /// takes part in the work, so nested calls from inside a task cannot deadlock. The body is called
+    /// through a plain function pointer and the loop state lives on the caller's stack, so a loop does
+    /// not allocate once the task queues have grown.
+    /// </summary>
+    /// <param name="begin"></param>
+    /// <param name="end"></param>
+    /// <param name="body"></param>
+    /// <param name="grain">Minimum number of indices per chunk</param>
+    template <class Body>
+    void parallel_for(size_t begin, size_t end, Body&& body, size_t grain = 1)
+    {
+        using body_type = remove_reference_t<Body>;
+        run_loop(begin, end, grain, addressof(body), [](const void* b, size_t i) {
+            (*static_cast<body_type*>(const_cast<void*>(b)))(i);
+        });
+    }
+
+private:
+
+    // Tasks of a worker, the oldest one at index head. The storage is kept when the queue runs empty,
+    // unlike a deque that frees and allocates its blocks as the tasks go through it.
+    struct Queue {
+        mutex mtx;
+        vector<function<void()>> tasks;
+        size_t head = 0;
+    };
+
+    // Calls the body of a parallel loop for one index
+    using LoopCall = void (*)(const void* body, size_t i);
+
+    struct Loop;
+
+    void run_loop(size_t begin, size_t end, size_t grain, const void* body, LoopCall call);
+
+    // Runs the chunks of a loop until none is left
+    static void run_chunks(Loop& loop);
+
+    void push(function<void()> task);
+
+    /// <summary>
+    /// Runs one task from the own queue or stolen from another worker, returns false if none was found.
+    /// A thread outside the pool passes the number of queues and only steals.
+    /// </summary>
+    bool run_one(size_t self);
+
+    void worker_loop(size_t index);
+
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> threads;
+
+    // CPUs the workers are pinned to, empty if they are not pinned
+    vector<int> cpus;
+
+    // Runs on every worker before its first task
+    function<void()> thread_init;
+
+    // Sleeping workers wait on this until a task is pushed, threads waiting for a parallel loop until a
+    // task is pushed or a helper of the loop finishes
+    mutex sleep_mtx;
+    condition_variable wake_up;
+    atomic<size_t> pending;
+    atomic<size_t> next_queue;
+    bool stopping;
+};
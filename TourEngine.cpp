@@ -0,0 +1,477 @@
+#include "TourEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Profiler.h"
+
+//------------------------------------------------------------------------------------------------------------------------
+// TwoLevelList class
+//------------------------------------------------------------------------------------------------------------------------
+TwoLevelList::TwoLevelList(const vector<int>& tour)
+    :num_cities(tour.size())
+{
+    segment_size = max<size_t>(8, static_cast<size_t>(sqrt(static_cast<double>(num_cities))));
+    segment_of.resize(num_cities);
+    index_of.resize(num_cities);
+    rebuild(tour);
+}
+
+
+void TwoLevelList::rebuild(const vector<int>& tour)
+{
+    segments.clear();
+    order.clear();
+
+    for (size_t start = 0; start < tour.size(); start += segment_size)
+    {
+        size_t end = min(start + segment_size, tour.size());
+        Segment s{ vector<int>(tour.begin() + start, tour.begin() + end), false, order.size() };
+
+        for (size_t k = 0; k < s.cities.size(); ++k)
+        {
+            segment_of[s.cities[k]] = segments.size();
+            index_of[s.cities[k]] = k;
+        }
+
+        order.push_back(segments.size());
+        segments.push_back(move(s));
+    }
+}
+
+
+int TwoLevelList::next(int city) const
+{
+    const Segment& s = segments[segment_of[city]];
+    size_t i = index_of[city];
+
+    if (!s.reversed)
+    {
+        if (i + 1 < s.cities.size())
+        {
+            return s.cities[i + 1];
+        }
+    }
+    else if (i > 0)
+    {
+        return s.cities[i - 1];
+    }
+
+    return first(order[(s.rank + 1) % order.size()]);
+}
+
+
+int TwoLevelList::prev(int city) const
+{
+    const Segment& s = segments[segment_of[city]];
+    size_t i = index_of[city];
+
+    if (!s.reversed)
+    {
+        if (i > 0)
+        {
+            return s.cities[i - 1];
+        }
+    }
+    else if (i + 1 < s.cities.size())
+    {
+        return s.cities[i + 1];
+    }
+
+    return last(order[(s.rank + order.size() - 1) % order.size()]);
+}
+
+
+bool TwoLevelList::between(int a, int b, int c) const
+{
+    auto key = [&](int city) { return make_pair(segments[segment_of[city]].rank, offset(city)); };
+    auto ka = key(a), kb = key(b), kc = key(c);
+
+    if (ka <= kc)
+    {
+        return ka <= kb && kb <= kc;
+    }
+    return kb >= ka || kb <= kc;
+}
+
+
+void TwoLevelList::split(int city)
+{
+    size_t seg = segment_of[city];
+    size_t off = offset(city);
+    if (off == 0)
+    {
+        return;
+    }
+
+    size_t size = segments[seg].cities.size();
+    bool reversed = segments[seg].reversed;
+
+    // Move the smaller part into a new segment, the head goes before the old segment and the tail after it
+    bool move_head = off <= size - off;
+    size_t lo = move_head ? 0 : off;
+    size_t hi = move_head ? off : size;
+
+    // Physical range of the part inside the segment storage
+    size_t plo = reversed ? size - hi : lo;
+    size_t phi = reversed ? size - lo : hi;
+
+    vector<int>& cities = segments[seg].cities;
+    Segment part{ vector<int>(cities.begin() + plo, cities.begin() + phi), reversed, 0 };
+    cities.erase(cities.begin() + plo, cities.begin() + phi);
+
+    if (plo == 0)
+    {
+        for (size_t k = 0; k < cities.size(); ++k)
+        {
+            index_of[cities[k]] = k;
+        }
+    }
+
+    size_t part_id = segments.size();
+    for (size_t k = 0; k < part.cities.size(); ++k)
+    {
+        segment_of[part.cities[k]] = part_id;
+        index_of[part.cities[k]] = k;
+    }
+
+    size_t pos = move_head ? segments[seg].rank : segments[seg].rank + 1;
+    segments.push_back(move(part));
+    order.insert(order.begin() + pos, part_id);
+
+    for (size_t k = pos; k < order.size(); ++k)
+    {
+        segments[order[k]].rank = k;
+    }
+}
+
+
+void TwoLevelList::reverse_path(int a, int b)
+{
+    if (a == b)
+    {
+        return;
+    }
+
+    size_t m;
+    size_t r1, count;
+
+    if (next(b) == a)
+    {
+        // The path is the whole tour
+        m = order.size();
+        r1 = 0;
+        count = m;
+    }
+    else
+    {
+        // Make the path start and end on segment boundaries
+        split(a);
+        split(next(b));
+
+        m = order.size();
+        r1 = segments[segment_of[a]].rank;
+        size_t r2 = segments[segment_of[b]].rank;
+        count = (r2 + m - r1) % m + 1;
+    }
+
+    // Reverse the order of the segments on the path and flip their reversal bits
+    for (size_t k = 0; k < count / 2; ++k)
+    {
+        swap(order[(r1 + k) % m], order[(r1 + count - 1 - k) % m]);
+    }
+    for (size_t k = 0; k < count; ++k)
+    {
+        size_t idx = (r1 + k) % m;
+        Segment& s = segments[order[idx]];
+        s.reversed = !s.reversed;
+        s.rank = idx;
+    }
+
+    // Every reversal adds at most two segments, rebalance once there are too many
+    size_t balanced = (num_cities + segment_size - 1) / segment_size;
+    if (order.size() > 2 * balanced + 8)
+    {
+        to_vector(first(order[0]), scratch);
+        rebuild(scratch);
+    }
+}
+
+
+void TwoLevelList::to_vector(int start, vector<int>& tour) const
+{
+    tour.resize(num_cities);
+    int city = start;
+
+    for (size_t i = 0; i < num_cities; ++i)
+    {
+        tour[i] = city;
+        city = next(city);
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------
+// TourEngine class
+//------------------------------------------------------------------------------------------------------------------------
+TourEngine::TourEngine(const DistanceOracle& distances, const CandidateLists& candidates)
+    :distances(distances), candidates(candidates)
+{
+}
+
+
+void TourEngine::wake(int city)
+{
+    if (!queued[city])
+    {
+        queued[city] = 1;
+        active.push_back(city);
+    }
+}
+
+
+double TourEngine::optimise(vector<int>& tour, const Deadline& deadline)
+{
+    // Or-opt needs a few cities outside the moved segment
+    if (tour.size() < 2 * max_segment + 2)
+    {
+        return 0.0;
+    }
+
+    ScopedTimer timer(Phase::TourEngine);
+
+    TwoLevelList list(tour);
+    queued.assign(tour.size(), 1);
+    active.assign(tour.begin(), tour.end());
+
+    double total_gain = 0.0;
+    uint64_t tried = 0, lk_applied = 0, or_opt_applied = 0;
+
+    while (!active.empty())
+    {
+        int city = active.front();
+        active.pop_front();
+        queued[city] = 0;
+        tried++;
+
+        // The clock is only read every 64 cities
+        if ((tried & 63) == 0 && deadline.expired())
+        {
+            break;
+        }
+
+        double gain = lin_kernighan(list, city, false);
+        if (gain <= 0.0)
+        {
+            gain = lin_kernighan(list, city, true);
+        }
+        if (gain > 0.0)
+        {
+            lk_applied++;
+        }
+        else
+        {
+            gain = or_opt(list, city);
+            or_opt_applied += gain > 0.0;
+        }
+
+        if (gain > 0.0)
+        {
+            total_gain += gain;
+            wake(city);
+        }
+    }
+
+    Profiler& profiler = Profiler::instance();
+    profiler.add(Counter::TourEngineTried, tried);
+    profiler.add(Counter::LinKernighanApplied, lk_applied);
+    profiler.add(Counter::OrOptApplied, or_opt_applied);
+
+    // Keep the starting city of the tour
+    int start = tour.front();
+    list.to_vector(start, tour);
+    return total_gain;
+}
+
+
+double TourEngine::lin_kernighan(TwoLevelList& list, int t1, bool backward)
+{
+    // A backward move is the mirror image of a forward one
+    auto succ = [&](int city) { return backward ? list.prev(city) : list.next(city); };
+    auto pred = [&](int city) { return backward ? list.next(city) : list.prev(city); };
+    auto flip = [&](int a, int b) { backward ? list.reverse_path(b, a) : list.reverse_path(a, b); };
+
+    struct Step {
+        int t2, t3, t4;
+    };
+    Step steps[max_depth];
+
+    int first_t2 = succ(t1);
+    double first_gain = distances(t1, first_t2);
+
+    // Try every candidate as the first added edge, deeper levels follow the best candidate only
+    for (const int* it = candidates.begin(first_t2); it != candidates.end(first_t2); ++it)
+    {
+        int t2 = first_t2;
+        int t3 = *it;
+        double g = first_gain;
+
+        // Candidates are sorted, no later one keeps the partial gain positive
+        if (g - distances(t2, t3) <= 0.0)
+        {
+            break;
+        }
+        if (t3 == t1 || t3 == succ(t2))
+        {
+            continue;
+        }
+
+        size_t depth = 0, best_depth = 0;
+        double best_gain = 0.0;
+
+        while (true)
+        {
+            // Remove (t1, t2) and (t4, t3), add (t2, t3) and (t1, t4)
+            int t4 = pred(t3);
+            g = g - distances(t2, t3) + distances(t4, t3);
+            flip(t2, t4);
+            steps[depth++] = Step{ t2, t3, t4 };
+
+            double gain = g - distances(t4, t1);
+            if (gain > best_gain + 1e-9)
+            {
+                best_gain = gain;
+                best_depth = depth;
+            }
+
+            t2 = t4;
+            if (depth == max_depth)
+            {
+                break;
+            }
+
+            // Choose the next added edge by the gain after also removing the edge to its predecessor
+            int best_t3 = -1;
+            double best_value = -numeric_limits<double>::infinity();
+            for (const int* c = candidates.begin(t2); c != candidates.end(t2); ++c)
+            {
+                double partial = g - distances(t2, *c);
+                if (partial <= 0.0)
+                {
+                    break;
+                }
+                if (*c == t1 || *c == succ(t2))
+                {
+                    continue;
+                }
+
+                double value = partial + distances(pred(*c), *c);
+                if (value > best_value)
+                {
+                    best_value = value;
+                    best_t3 = *c;
+                }
+            }
+
+            if (best_t3 < 0)
+            {
+                break;
+            }
+            t3 = best_t3;
+        }
+
+        // Undo the moves beyond the best depth
+        while (depth > best_depth)
+        {
+            --depth;
+            flip(steps[depth].t4, steps[depth].t2);
+        }
+
+        if (best_depth > 0)
+        {
+            wake(t1);
+            for (size_t k = 0; k < best_depth; ++k)
+            {
+                wake(steps[k].t2);
+                wake(steps[k].t3);
+                wake(steps[k].t4);
+            }
+            return best_gain;
+        }
+    }
+
+    return 0.0;
+}
+
+
+double TourEngine::or_opt(TwoLevelList& list, int s1)
+{
+    int s2 = s1;
+
+    for (size_t length = 1; length <= max_segment; ++length, s2 = list.next(s2))
+    {
+        int p = list.prev(s1);
+        int nx = list.next(s2);
+
+        // Gain of removing the segment and joining its neighbours
+        double removal = distances(p, s1) + distances(s2, nx) - distances(p, nx);
+        if (removal <= 1e-9)
+        {
+            continue;
+        }
+
+        for (int end_city : { s1, s2 })
+        {
+            for (const int* c = candidates.begin(end_city); c != candidates.end(end_city); ++c)
+            {
+                if (distances(end_city, *c) >= removal)
+                {
+                    break;
+                }
+                if (list.between(s1, *c, s2))
+                {
+                    continue;
+                }
+
+                // Insert between the candidate and its successor or its predecessor
+                for (int side = 0; side < 2; ++side)
+                {
+                    int u = side == 0 ? *c : list.prev(*c);
+                    int v = side == 0 ? list.next(*c) : *c;
+                    if (list.between(s1, u, s2) || list.between(s1, v, s2))
+                    {
+                        continue;
+                    }
+
+                    double base = distances(u, v);
+                    double forward = distances(u, s1) + distances(s2, v) - base;
+                    double backward = distances(u, s2) + distances(s1, v) - base;
+                    double gain = removal - min(forward, backward);
+                    if (gain <= 1e-9)
+                    {
+                        continue;
+                    }
+
+                    // p s1..s2 nx .. u v becomes p nx .. u s2..s1 v with two reversals
+                    list.reverse_path(s1, u);
+                    list.reverse_path(u, nx);
+                    if (forward < backward)
+                    {
+                        list.reverse_path(s2, s1);
+                    }
+
+                    wake(p);
+                    wake(nx);
+                    wake(s1);
+                    wake(s2);
+                    wake(u);
+                    wake(v);
+                    return gain;
+                }
+            }
+        }
+    }
+
+    return 0.0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <deque>
+#include <vector>
+
+#include "CandidateLists.h"
+#include "Deadline.h"
+#include "DistanceOracle.h"
+
+using namespace std;
+
+/// <summary>
+/// Two-level doubly-linked list representation of a tour. The tour is cut into segments of about
+/// sqrt(N) cities, each with a reversal bit, so next/prev/between are O(1) and reversing a path
+/// costs O(sqrt(N)) instead of O(N) for an array.
+/// </summary>
+class TwoLevelList {
+public:
+    TwoLevelList(const vector<int>& tour);
+
+    /// <summary>
+    /// Returns the city after the given city in the tour
+    /// </summary>
+    int next(int city) const;
+
+    /// <summary>
+    /// Returns the city before the given city in the tour
+    /// </summary>
+    int prev(int city) const;
+
+    /// <summary>
+    /// Returns true if b lies on the forward path from a to c, both ends included
+    /// </summary>
+    bool between(int a, int b, int c) const;
+
+    /// <summary>
+    /// Reverses the forward path from a to b
+    /// </summary>
+    void reverse_path(int a, int b);
+
+    /// <summary>
+    /// Writes the tour to an array, starting with the given city
+    /// </summary>
+    void to_vector(int start, vector<int>& tour) const;
+
+private:
+
+    struct Segment {
+        vector<int> cities;
+        bool reversed;
+        size_t rank;
+    };
+
+    inline size_t offset(int city) const
+    {
+        const Segment& s = segments[segment_of[city]];
+        return s.reversed ? s.cities.size() - 1 - index_of[city] : index_of[city];
+    }
+
+    inline int first(size_t seg) const
+    {
+        const Segment& s = segments[seg];
+        return s.reversed ? s.cities.back() : s.cities.front();
+    }
+
+    inline int last(size_t seg) const
+    {
+        const Segment& s = segments[seg];
+        return s.reversed ? s.cities.front() : s.cities.back();
+    }
+
+    /// <summary>
+    /// Splits the segment of the city so that the city becomes the first city of its segment
+    /// </summary>
+    void split(int city);
+
+    /// <summary>
+    /// Rebuilds balanced segments from the current tour
+    /// </summary>
+    void rebuild(const vector<int>& tour);
+
+    // Number of cities
+    size_t num_cities;
+
+    // Target number of cities per segment
+    size_t segment_size;
+
+    // Segment storage, order holds the segment ids in tour order
+    vector<Segment> segments;
+    vector<size_t> order;
+
+    // Segment of every city and its index inside the segment storage
+    vector<size_t> segment_of;
+    vector<size_t> index_of;
+
+    // Scratch tour used when rebuilding
+    vector<int> scratch;
+};
+
+
+/// <summary>
+/// Tour improvement engine running Or-opt and a Lin-Kernighan style variable-depth move on a
+/// two-level list tour. Only candidate edges are considered and don't-look bits keep the search
+/// on the cities whose edges changed recently.
+/// </summary>
+class TourEngine {
+public:
+    // Maximum number of 2-opt moves chained in a single Lin-Kernighan move
+    static constexpr size_t max_depth = 6;
+
+    // Longest segment moved by Or-opt
+    static constexpr size_t max_segment = 3;
+
+    TourEngine(const DistanceOracle& distances, const CandidateLists& candidates);
+
+    /// <summary>
+    /// Improves the tour until no Or-opt or Lin-Kernighan move improves it or the deadline expires.
+    /// The first city of the tour is kept.
+    /// </summary>
+    /// <param name="tour"></param>
+    /// <param name="deadline"></param>
+    /// <returns>double, the reduction of the tour length</returns>
+    double optimise(vector<int>& tour, const Deadline& deadline = Deadline());
+
+private:
+
+    /// <summary>
+    /// Variable-depth move starting from the edge (t1, next(t1)), or (t1, prev(t1)) when backward
+    /// </summary>
+    double lin_kernighan(TwoLevelList& list, int t1, bool backward);
+
+    /// <summary>
+    /// Moves a segment of up to max_segment cities starting at s1 next to one of its candidates
+    /// </summary>
+    double or_opt(TwoLevelList& list, int s1);
+
+    void wake(int city);
+
+    // Distance oracle
+    const DistanceOracle& distances;
+
+    // Nearest neighbour candidates
+    const CandidateLists& candidates;
+
+    // Queue of the cities whose don't-look bit is off
+    deque<int> active;
+    vector<char> queued;
+};
@@ -0,0 +1,112 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "InstanceCache.h"
+
+using namespace std;
+
+// Checks that the cache written for an instance is read back, also when the instance has fewer cities than
+// the number of candidates asked for, and that a damaged cache is not
+
+namespace {
+    const char* instance_text =
+        "PROBLEM NAME: \tTest\n"
+        "KNAPSACK DATA TYPE: unknown\n"
+        "DIMENSION:\t4\n"
+        "NUMBER OF ITEMS: \t3\n"
+        "CAPACITY OF KNAPSACK: \t80\n"
+        "MIN SPEED: \t0.1\n"
+        "MAX SPEED: \t1\n"
+        "RENTING RATIO:  1.516\n"
+        "EDGE_WEIGHT_TYPE:\tCEIL_2D\n"
+        "NODE_COORD_SECTION\t(INDEX, X, Y): \n"
+        "1 0 0\n"
+        "2 4 0\n"
+        "3 8 3\n"
+        "4 0 3\n"
+        "ITEMS SECTION\t(INDEX, PROFIT, WEIGHT, ASSIGNED NODE NUMBER): \n"
+        "1\t34\t30\t2\n"
+        "2\t40\t40\t3\n"
+        "3\t25\t21\t4\n";
+}
+
+
+int main()
+{
+    filesystem::path directory = filesystem::temp_directory_path() / "pso-instance-cache-test";
+    filesystem::create_directories(directory);
+    string file_path = (directory / "test-example-n4.txt").string();
+    {
+        ofstream file(file_path);
+        file << instance_text;
+    }
+    filesystem::remove(InstanceCache::cache_path(file_path));
+
+    int failures = 0;
+
+    // The first load parses the file and writes the cache, with the candidates clamped to 3
+    Instance parsed = load_instance(file_path, CandidateLists::default_k);
+    if (!filesystem::exists(InstanceCache::cache_path(file_path)))
+    {
+        cerr << "no cache was written" << endl;
+        failures++;
+    }
+
+    Instance cached;
+    if (!InstanceCache::load(file_path, CandidateLists::default_k, cached))
+    {
+        cerr << "the cache was not read back with the number of candidates it was written with" << endl;
+        failures++;
+    }
+    else if (cached.candidates->size() != parsed.candidates->size() || cached.items->size() != parsed.items->size())
+    {
+        cerr << "the cached instance differs from the parsed one" << endl;
+        failures++;
+    }
+
+    // A different number of candidates that is not clamped to the same value needs new lists
+    Instance other;
+    if (InstanceCache::load(file_path, 2, other))
+    {
+        cerr << "the cache was read back with a different number of candidates" << endl;
+        failures++;
+    }
+
+    // Only the cache is left next to the instance, the temporary file was renamed into place
+    for (const auto& entry : filesystem::directory_iterator(directory))
+    {
+        if (entry.path().extension() == ".tmp")
+        {
+            cerr << "a temporary file was left behind: " << entry.path() << endl;
+            failures++;
+        }
+    }
+
+    // A cache with a damaged section, as another writer or a crash could leave it, is rejected
+    {
+        fstream file(InstanceCache::cache_path(file_path), ios::in | ios::out | ios::binary);
+        file.seekg(0, ios::end);
+        streamoff last = static_cast<streamoff>(file.tellg()) - 1;
+        file.seekg(last);
+        char byte = static_cast<char>(file.get());
+        file.seekp(last);
+        file.put(static_cast<char>(byte ^ 0x5a));
+    }
+    Instance damaged;
+    if (InstanceCache::load(file_path, CandidateLists::default_k, damaged))
+    {
+        cerr << "a damaged cache was read back" << endl;
+        failures++;
+    }
+
+    filesystem::remove_all(directory);
+
+    if (failures > 0)
+    {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "Instance cache is read back" << endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "Mailbox.h"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Checks that a shared mailbox created over the object of an earlier run starts empty, and that the other
+// process attaches to the new ring, also when it starts before the creator, but not to the ring of a creator
+// that has exited
+
+int main()
+{
+#ifdef _WIN32
+    cout << "Shared mailboxes need POSIX shared memory" << endl;
+    return 0;
+#else
+    const string name = "/pso-mailbox-test-" + to_string(getpid());
+    int failures = 0;
+
+    // A run that stops without removing its object leaves a message and the indices behind
+    {
+        Mailbox stale(name, 64, 4, true);
+        const char message[] = "stale";
+        if (!stale.is_open() || !stale.push(message, sizeof(message)))
+        {
+            cerr << "the first ring could not be written" << endl;
+            failures++;
+        }
+    }
+
+    // The sender may start before the creator, it attaches on its first push after the ring is created
+    const string early_name = name + "-early";
+    Mailbox early(early_name, 64, 4, false);
+    const char early_message[] = "early";
+    if (early.is_open() || early.push(early_message, sizeof(early_message)))
+    {
+        cerr << "the sender attached to a ring that was not created" << endl;
+        failures++;
+    }
+    Mailbox late_inbox(early_name, 64, 4, true);
+    vector<char> received;
+    if (!early.push(early_message, sizeof(early_message)) || !late_inbox.pop(received))
+    {
+        cerr << "the sender did not attach once the ring was created" << endl;
+        failures++;
+    }
+    Mailbox::unlink(early_name);
+
+    // A sender does not attach to a ring whose creator has exited without removing it
+    const string orphan_name = name + "-orphan";
+    pid_t child = fork();
+    if (child == 0)
+    {
+        Mailbox orphan(orphan_name, 64, 4, true);
+        _exit(orphan.is_open() ? 0 : 1);
+    }
+    int status = 1;
+    waitpid(child, &status, 0);
+    Mailbox orphan_outbox(orphan_name, 64, 4, false);
+    if (status != 0 || orphan_outbox.push(early_message, sizeof(early_message)))
+    {
+        cerr << "the sender attached to the ring of an exited creator" << endl;
+        failures++;
+    }
+    Mailbox::unlink(orphan_name);
+
+    Mailbox inbox(name, 64, 4, true);
+    Mailbox outbox(name, 64, 4, false);
+    if (!inbox.is_open() || !outbox.is_open())
+    {
+        cerr << "the ring was not created over the stale object, or the sender did not attach" << endl;
+        failures++;
+    }
+
+    if (inbox.pop(received))
+    {
+        cerr << "the new ring holds a message of the stale one" << endl;
+        failures++;
+    }
+
+    const char message[] = "fresh";
+    if (!outbox.push(message, sizeof(message)) || !inbox.pop(received) || received.size() != sizeof(message)
+        || memcmp(received.data(), message, sizeof(message)) != 0)
+    {
+        cerr << "a message of the sender did not reach the creator" << endl;
+        failures++;
+    }
+
+    Mailbox::unlink(name);
+
+    if (failures > 0)
+    {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "Shared mailboxes start empty" << endl;
+    return 0;
+#endif
+}
@@ -0,0 +1,101 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "HelperFunctions.h"
+
+using namespace std;
+
+// Checks that the parser reads an EXPLICIT instance and reports a malformed one with an exception, instead of
+// looping on a token it cannot consume or ending the process
+
+namespace {
+    string instance_text(const string& second_row)
+    {
+        return "PROBLEM NAME: \tTest\n"
+            "KNAPSACK DATA TYPE: unknown\n"
+            "DIMENSION:\t4\n"
+            "NUMBER OF ITEMS: \t3\n"
+            "CAPACITY OF KNAPSACK: \t80\n"
+            "MIN SPEED: \t0.1\n"
+            "MAX SPEED: \t1\n"
+            "RENTING RATIO:  1.516\n"
+            "EDGE_WEIGHT_TYPE:\tEXPLICIT\n"
+            "EDGE_WEIGHT_FORMAT:\tFULL_MATRIX\n"
+            "EDGE_WEIGHT_SECTION\n"
+            "0 4 9 3\r\n"
+            + second_row + "\n"
+            "9 5 0 8\n"
+            "3 5 8 0\n"
+            "ITEMS SECTION\t(INDEX, PROFIT, WEIGHT, ASSIGNED NODE NUMBER): \n"
+            "1\t34\t30\t2\n"
+            "2\t40\t40\t3\n"
+            "3\t25\t21\t4\n";
+    }
+
+    // Parses the text, returns false if the parser threw
+    bool parses(const filesystem::path& file_path, const string& text, ParsedData& parsed_data)
+    {
+        {
+            ofstream file(file_path);
+            file << text;
+        }
+        try
+        {
+            parsed_data = parse_bttp_file(file_path.string());
+            return true;
+        }
+        catch (const runtime_error&)
+        {
+            return false;
+        }
+    }
+}
+
+
+int main()
+{
+    filesystem::path directory = filesystem::temp_directory_path() / "pso-parser-test";
+    filesystem::create_directories(directory);
+    filesystem::path file_path = directory / "explicit-n4.txt";
+
+    int failures = 0;
+    ParsedData parsed_data;
+
+    if (!parses(file_path, instance_text("4 0 6 5"), parsed_data) || parsed_data.edge_weights.size() != 16
+        || parsed_data.edge_weights[6] != 6)
+    {
+        cerr << "the edge weights of a valid instance were not read" << endl;
+        failures++;
+    }
+    if (parses(file_path, instance_text("4 0 x 5"), parsed_data))
+    {
+        cerr << "a token that is not a number was accepted" << endl;
+        failures++;
+    }
+    if (parses(file_path, instance_text("4 0 6"), parsed_data))
+    {
+        cerr << "a matrix with a missing weight was accepted" << endl;
+        failures++;
+    }
+    try
+    {
+        parse_bttp_file((directory / "does-not-exist.txt").string());
+        cerr << "a missing file was accepted" << endl;
+        failures++;
+    }
+    catch (const runtime_error&)
+    {
+    }
+
+    filesystem::remove_all(directory);
+
+    if (failures > 0)
+    {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "Parser reads valid instances and rejects malformed ones" << endl;
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "CandidateLists.h"
+#include "DistanceOracle.h"
+#include "HelperClasses.h"
+#include "HelperFunctions.h"
+#include "InstanceContext.h"
+#include "ItemStore.h"
+
+using namespace std;
+
+// Checks that a steady-state iteration of a swarm does not allocate. Every operator new of the process goes
+// through the counter below, so the test is a program of its own.
+
+static atomic<size_t> allocation_count(0);
+
+void* operator new(size_t size)
+{
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// GCC pairs free with the standard operator new and warns, the replacement above uses malloc
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: SwarmAllocationTest <instance file>" << endl;
+        return 1;
+    }
+
+    ParsedData parsed_data = parse_bttp_file(argv[1]);
+    size_t num_cities = static_cast<size_t>(parsed_data.metadata["DIMENSION"]);
+    size_t num_items = static_cast<size_t>(parsed_data.metadata["NUMBER_OF_ITEMS"]) + 1;
+
+    ItemStore items(parsed_data.items, num_cities);
+    DistanceOracle distances(parsed_data);
+    CandidateLists candidates(parsed_data.nodes);
+    InstanceContext context(distances, candidates, items);
+
+    // A fixed seed and a pool of its own, the swarm takes the same path on every run
+    const size_t swarm_size = 10;
+    const size_t warm_iterations = 50;
+    const size_t checked_iterations = 20;
+    ThreadPool pool(2);
+    PSO swarm(swarm_size, context, num_cities, num_items, parsed_data.metadata["CAPACITY"],
+        parsed_data.metadata["MAX_SPEED"], parsed_data.metadata["MIN_SPEED"], parsed_data.metadata["RENTING_RATIO"],
+        LocalSearchMode::Restrictive, 1, Deadline(), pool);
+    swarm.run(warm_iterations, 0.9, 1.4, 1.5);
+
+    // Every evaluated particle may add a point to the front
+    swarm.reserve_front(swarm.pareto_front().size() + swarm_size * checked_iterations);
+
+    int failures = 0;
+    for (size_t iteration = 0; iteration < checked_iterations; ++iteration)
+    {
+        size_t before = allocation_count.load(memory_order_relaxed);
+        swarm.run(1, 0.9, 1.4, 1.5);
+        size_t allocations = allocation_count.load(memory_order_relaxed) - before;
+        if (allocations > 0)
+        {
+            cerr << "iteration " << iteration << " allocated " << allocations << " times" << endl;
+            failures++;
+        }
+    }
+
+    if (failures > 0)
+    {
+        cerr << failures << " iterations allocated" << endl;
+        return 1;
+    }
+    cout << "Steady-state swarm iterations do not allocate" << endl;
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include "DistanceOracle.h"
+#include "ItemStore.h"
+#include "PickingPlan.h"
+#include "Random.h"
+#include "TTPEvaluator.h"
+
+using namespace std;
+
+// Checks the incremental deltas of the TTP evaluator against full evaluations, on a random instance
+
+namespace {
+    const size_t num_cities = 80;
+    const size_t items_per_city = 3;
+    const double v_max = 1.0;
+    const double v_min = 0.1;
+    const double rent_rate = 0.7;
+
+    int failures = 0;
+
+    void expect_close(double expected, double actual, const char* what)
+    {
+        if (fabs(expected - actual) > 1e-6 * max(1.0, fabs(expected)))
+        {
+            cerr << what << ": expected " << expected << ", got " << actual << endl;
+            failures++;
+        }
+    }
+
+    double fitness_of(TTPEvaluator& evaluator, const vector<int>& tour, const PickingPlan& plan)
+    {
+        evaluator.build(tour, plan);
+        return evaluator.fitness();
+    }
+
+    // Segment reversals applied one after the other, every third one without scoring it first
+    void check_reversals(TTPEvaluator& evaluator, TTPEvaluator& reference, vector<int>& tour,
+        const PickingPlan& plan, Xoshiro256& rng)
+    {
+        evaluator.build(tour, plan);
+        for (int move = 0; move < 200; ++move)
+        {
+            size_t first = 1 + static_cast<size_t>(rng.uniform() * (num_cities - 2));
+            size_t last = first + 1 + static_cast<size_t>(rng.uniform() * (num_cities - 1 - first));
+            last = min(last, num_cities - 1);
+
+            double before = fitness_of(reference, tour, plan);
+            reverse(tour.begin() + first, tour.begin() + last + 1);
+            double after = fitness_of(reference, tour, plan);
+
+            if (move % 3 != 2)
+            {
+                expect_close(after - before, evaluator.reverse_delta(first, last), "reverse_delta");
+            }
+            evaluator.apply_reverse(first, last);
+            expect_close(after, evaluator.fitness(), "apply_reverse");
+        }
+    }
+}
+
+
+int main()
+{
+    Xoshiro256 rng(11);
+
+    vector<pair<double, double>> coordinates(num_cities);
+    for (auto& c : coordinates)
+    {
+        c = { rng.uniform() * 1000, rng.uniform() * 1000 };
+    }
+    DistanceOracle distances(coordinates);
+
+    // Item 0 is the placeholder of the instance files, the first city has no items
+    vector<tuple<int, int, int, int>> item_list = { { 0, 0, 0, 0 } };
+    double total_weight = 0;
+    for (size_t city = 1; city < num_cities; ++city)
+    {
+        for (size_t k = 0; k < items_per_city; ++k)
+        {
+            int weight = 1 + static_cast<int>(rng.uniform() * 100);
+            int profit = 1 + static_cast<int>(rng.uniform() * 100);
+            item_list.emplace_back(static_cast<int>(item_list.size()), profit, weight, static_cast<int>(city));
+            total_weight += weight;
+        }
+    }
+    ItemStore items(item_list, num_cities);
+    double capacity = 0.3 * total_weight;
+
+    TTPEvaluator evaluator(distances, items, capacity, rent_rate, v_max, v_min);
+    TTPEvaluator reference(distances, items, capacity, rent_rate, v_max, v_min);
+
+    vector<int> tour(num_cities);
+    iota(tour.begin(), tour.end(), 0);
+    shuffle(tour.begin() + 1, tour.end(), rng);
+
+    // A random plan over the capacity is repaired to one that fits, and repairing it again changes nothing
+    PickingPlan plan(item_list.size());
+    for (size_t i = 1; i < item_list.size(); ++i)
+    {
+        plan.set(i, rng.uniform() < 0.5);
+    }
+    if (evaluator.repair(tour, plan) == 0 || static_cast<double>(masked_sum(plan, items.weight_data())) > capacity)
+    {
+        cerr << "repair did not bring the plan within the capacity" << endl;
+        failures++;
+    }
+    if (evaluator.repair(tour, plan) != 0)
+    {
+        cerr << "repair dropped items from a plan that fits" << endl;
+        failures++;
+    }
+
+    // Exact flip deltas
+    evaluator.build(tour, plan);
+    double fitness = evaluator.fitness();
+    for (size_t i = 1; i < item_list.size(); ++i)
+    {
+        double delta = evaluator.flip_delta(i, plan[i], false);
+        if (isinf(delta))
+        {
+            continue;
+        }
+        PickingPlan flipped = plan;
+        flipped.flip(i);
+        expect_close(fitness_of(reference, tour, flipped) - fitness, delta, "flip_delta");
+    }
+
+    // Reversals with the plan, and with an empty plan where no segment carries weight
+    check_reversals(evaluator, reference, tour, plan, rng);
+    check_reversals(evaluator, reference, tour, PickingPlan(item_list.size()), rng);
+
+    if (failures > 0)
+    {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "TTPEvaluator deltas match full evaluations" << endl;
+    return 0;
+}
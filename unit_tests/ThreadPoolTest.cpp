@@ -0,0 +1,82 @@
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Checks that parallel loops, nested ones included, run every index once, pass exceptions to the caller and
+// return when the caller has to wait for the helpers, also on a pool without workers
+
+int main()
+{
+    ThreadPool pool(4);
+    int failures = 0;
+
+    for (int rep = 0; rep < 200; ++rep)
+    {
+        // Nested loops from the workers, the outer caller is outside the pool
+        vector<atomic<int>> hits(100);
+        pool.parallel_for(0, 10, [&](size_t i) {
+            pool.parallel_for(0, 10, [&](size_t j) { hits[i * 10 + j]++; });
+        });
+        for (auto& h : hits)
+        {
+            if (h != 1)
+            {
+                failures++;
+                break;
+            }
+        }
+
+        bool caught = false;
+        try
+        {
+            pool.parallel_for(0, 50, [&](size_t i) {
+                if (i == 17)
+                {
+                    throw runtime_error("loop body failed");
+                }
+            });
+        }
+        catch (const runtime_error&)
+        {
+            caught = true;
+        }
+        if (!caught)
+        {
+            failures++;
+        }
+    }
+
+    if (pool.submit([]() { return 42; }).get() != 42)
+    {
+        failures++;
+    }
+
+    // Without workers the calling thread runs everything
+    ThreadPool inline_pool(0);
+    vector<int> counts(20, 0);
+    inline_pool.parallel_for(0, counts.size(), [&](size_t i) { counts[i]++; });
+    for (int count : counts)
+    {
+        if (count != 1)
+        {
+            failures++;
+            break;
+        }
+    }
+    if (inline_pool.submit([]() { return 42; }).get() != 42)
+    {
+        failures++;
+    }
+
+    if (failures > 0)
+    {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "Parallel loops ran every index once" << endl;
+    return 0;
+}